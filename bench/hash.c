@@ -0,0 +1,101 @@
+/**
+ * Benchmark of the hash of std::hash (wyhash, c/hash.c) against the polynomial hash it replaced
+ * It measures the throughput on keys of different sizes, and the distribution of similar keys (e.g. "key0", "key1", ...) in the buckets of a hash map.
+ *
+ * Build and run (not part of the runtime library) :
+ *     gcc -O2 -o bench_hash bench/hash.c c/hash.c && ./bench_hash
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+uint64_t _yrt_hash_bytes (const void * key, uint64_t len, uint64_t seed);
+
+/**
+ * The hash of [c8] before wyhash (polynomial rolling hash modulo 1e9+9)
+ */
+static uint64_t _bench_poly_hash (const void * key, uint64_t len, uint64_t seed) {
+    (void) seed;
+    const uint8_t * p = (const uint8_t*) key;
+    const uint64_t m = 1000000009ULL;
+    uint64_t h = 0, pow = 1;
+    for (uint64_t i = 0 ; i < len ; i++) {
+	h = (h + ((uint64_t) p [i] + 1) * pow) % m;
+	pow = (pow * 31) % m;
+    }
+
+    return h;
+}
+
+static double _bench_now () {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+typedef uint64_t (*_bench_hash_fn) (const void*, uint64_t, uint64_t);
+
+/**
+ * @returns: the throughput in MB/s of a hash function on keys of len bytes
+ */
+static double _bench_throughput (_bench_hash_fn f, const uint8_t * data, uint64_t len, uint64_t * sink) {
+    uint64_t iters = (1ULL << 28) / (len + 8);
+    if (iters < 16) iters = 16;
+
+    double start = _bench_now ();
+    uint64_t acc = 0;
+    for (uint64_t i = 0 ; i < iters ; i++) {
+	acc += f (data + (i & 7), len, acc);
+    }
+
+    double t = _bench_now () - start;
+    *sink ^= acc;
+    return ((double) iters * (double) len) / t / 1e6;
+}
+
+/**
+ * @returns: the length of the longest chain when n similar keys are stored in a map of 2^bits buckets (indexed by the low bits of the hash)
+ */
+static uint64_t _bench_longest_chain (_bench_hash_fn f, uint64_t n, int bits) {
+    uint64_t nbBuckets = 1ULL << bits;
+    uint32_t * buckets = calloc (nbBuckets, sizeof (uint32_t));
+    if (buckets == NULL) return 0;
+
+    char key [32];
+    uint64_t longest = 0;
+    for (uint64_t i = 0 ; i < n ; i++) {
+	int len = snprintf (key, sizeof (key), "key%llu", (unsigned long long) i);
+	uint64_t b = f (key, (uint64_t) len, 0x1234) & (nbBuckets - 1);
+	buckets [b] += 1;
+	if (buckets [b] > longest) longest = buckets [b];
+    }
+
+    free (buckets);
+    return longest;
+}
+
+int main () {
+    static const uint64_t sizes [] = {4, 8, 16, 32, 64, 256, 1024, 65536};
+    uint8_t * data = malloc (65536 + 8);
+    if (data == NULL) return 1;
+    for (int i = 0 ; i < 65536 + 8 ; i++) data [i] = (uint8_t) (i * 131 + 7);
+
+    uint64_t sink = 0;
+    printf ("%-10s %15s %15s\n", "key size", "poly (MB/s)", "wyhash (MB/s)");
+    for (size_t i = 0 ; i < sizeof (sizes) / sizeof (sizes [0]) ; i++) {
+	double poly = _bench_throughput (&_bench_poly_hash, data, sizes [i], &sink);
+	double wy = _bench_throughput (&_yrt_hash_bytes, data, sizes [i], &sink);
+	printf ("%-10llu %15.1f %15.1f\n", (unsigned long long) sizes [i], poly, wy);
+    }
+
+    printf ("\nlongest chain, 1M keys \"key<i>\" in 2^20 buckets : poly = %llu, wyhash = %llu\n",
+	    (unsigned long long) _bench_longest_chain (&_bench_poly_hash, 1 << 20, 20),
+	    (unsigned long long) _bench_longest_chain (&_yrt_hash_bytes, 1 << 20, 20));
+
+    printf ("(checksum %llx)\n", (unsigned long long) sink); // keeps the hashes from being optimized away
+    free (data);
+    return 0;
+}
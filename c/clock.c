@@ -0,0 +1,107 @@
+#define _GNU_SOURCE // clock_nanosleep
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined (__x86_64__) // the conversion of the ticks uses unsigned __int128, that does not exist on i386
+#  include <cpuid.h>
+#  include <x86intrin.h>
+#  define _YRT_HAS_TSC
+#endif
+
+/**
+ * @returns: the current time of the monotonic clock in nanoseconds
+ * The clock is not affected by the changes of the system time (NTP, settimeofday), and is read through the vDSO, so without a syscall on linux.
+ */
+uint64_t _yrt_monotonic_now () {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Sleep until the monotonic clock reaches a given time
+ * @params:
+ *    - deadline: the time in nanoseconds (as returned by _yrt_monotonic_now)
+ * @info: the sleep is resumed when interrupted by a signal, without accumulating drift
+ */
+void _yrt_monotonic_sleep_until (uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = (time_t) (deadline / 1000000000ULL);
+    ts.tv_nsec = (long) (deadline % 1000000000ULL);
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+/**
+ * The conversion of TSC ticks to nanoseconds : ns = base_ns + ((ticks - base_ticks) * mult) >> 32
+ * mult is 0 when the TSC is not usable
+ */
+static uint64_t _yrt_tsc_mult = 0;
+static uint64_t _yrt_tsc_base_ticks = 0;
+static uint64_t _yrt_tsc_base_ns = 0;
+static int _yrt_tsc_state = 0; // 0 not calibrated, 1 calibration in progress, 2 calibrated
+
+/**
+ * Calibrate the timestamp counter against the monotonic clock
+ * The TSC is only used if it is invariant (constant rate, not stopped in deep C-states), otherwise the fast clock falls back to the monotonic clock.
+ * @params:
+ *    - nsec: the duration of the calibration in nanoseconds (the longer the more precise, 10ms gives an error below 1e-5)
+ * @returns: 1 if the TSC can be used, 0 otherwise
+ * @info: the calibration is only made once, the next calls return the result of the first one
+ */
+int _yrt_tsc_calibrate (uint64_t nsec) {
+    int expected = 0;
+    if (!__atomic_compare_exchange_n (&_yrt_tsc_state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	while (__atomic_load_n (&_yrt_tsc_state, __ATOMIC_ACQUIRE) != 2) {} // calibrated by another thread
+	return _yrt_tsc_mult != 0;
+    }
+
+#ifdef _YRT_HAS_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx) || (edx & (1u << 8)) == 0) {
+	__atomic_store_n (&_yrt_tsc_state, 2, __ATOMIC_RELEASE);
+	return 0;
+    }
+
+    uint64_t ns0 = _yrt_monotonic_now (), t0 = __rdtsc ();
+    uint64_t ns1 = ns0, t1 = t0;
+    while (ns1 - ns0 < nsec) {
+	ns1 = _yrt_monotonic_now ();
+	t1 = __rdtsc ();
+    }
+
+    if (t1 <= t0) {
+	__atomic_store_n (&_yrt_tsc_state, 2, __ATOMIC_RELEASE);
+	return 0;
+    }
+
+    // 32.32 fixed point, precise enough for frequencies above 1MHz
+    _yrt_tsc_mult = (uint64_t) (((unsigned __int128) (ns1 - ns0) << 32) / (t1 - t0));
+    _yrt_tsc_base_ticks = t1;
+    _yrt_tsc_base_ns = ns1;
+    __atomic_store_n (&_yrt_tsc_state, 2, __ATOMIC_RELEASE);
+    return 1;
+#else
+    (void) nsec;
+    __atomic_store_n (&_yrt_tsc_state, 2, __ATOMIC_RELEASE);
+    return 0;
+#endif
+}
+
+/**
+ * @returns: the current time of the monotonic clock in nanoseconds, computed from the TSC if it was calibrated
+ * The result is on the same time base as _yrt_monotonic_now, but costs a few nanoseconds instead of ~20ns.
+ * @warning: the TSC drifts slowly from the monotonic clock (NTP slews the latter), so the fast clock should be used for short measurements
+ */
+uint64_t _yrt_tsc_now () {
+#ifdef _YRT_HAS_TSC
+    if (__atomic_load_n (&_yrt_tsc_state, __ATOMIC_ACQUIRE) == 2 && _yrt_tsc_mult != 0) {
+	uint64_t t = __rdtsc ();
+	if (t >= _yrt_tsc_base_ticks) { // another core with a slightly late counter could go before the base
+	    return _yrt_tsc_base_ns + (uint64_t) (((unsigned __int128) (t - _yrt_tsc_base_ticks) * _yrt_tsc_mult) >> 32);
+	}
+    }
+#endif
+    return _yrt_monotonic_now ();
+}
@@ -0,0 +1,188 @@
+#ifdef __linux__
+
+#define _GNU_SOURCE // O_DIRECTORY, AT_*
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "gc.h"
+#include "yarray.h"
+
+/**
+ * The record written by getdents64 (there is no glibc wrapper before 2.30)
+ */
+struct _yrt_linux_dirent64_ {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name [];
+};
+
+/**
+ * An entry of a directory, read by _yrt_dir_read (std::fs::walk::RawEntry)
+ */
+typedef struct _yrt_walk_entry_ {
+    _yrt_c8_array_ name;
+    uint64_t ino;
+    uint8_t type;
+} _yrt_walk_entry_;
+
+/**
+ * The result of fstatat (std::fs::walk::EntryStat)
+ */
+typedef struct _yrt_entry_stat_ {
+    uint64_t size;
+    uint64_t ino;
+    uint64_t nlink;
+    int64_t mtime;
+    int64_t mtimeNsec;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+} _yrt_entry_stat_;
+
+static uint8_t _yrt_dir_mode_type (mode_t mode) {
+    switch (mode & S_IFMT) {
+    case S_IFREG: return DT_REG;
+    case S_IFDIR: return DT_DIR;
+    case S_IFLNK: return DT_LNK;
+    case S_IFIFO: return DT_FIFO;
+    case S_IFSOCK: return DT_SOCK;
+    case S_IFCHR: return DT_CHR;
+    case S_IFBLK: return DT_BLK;
+    default: return DT_UNKNOWN;
+    }
+}
+
+/**
+ * Open a directory relatively to another one
+ * @params:
+ *    - dirfd: the directory of reference, or AT_FDCWD if name is absolute or relative to the cwd
+ *    - name: the null terminated name of the directory
+ *    - follow: if false and name is a link, the opening fails (the entries of a walk), if true the link is followed (the root of a walk)
+ * @returns: the file descriptor of the directory, -1 on failure (the reason is left in errno)
+ */
+int _yrt_dir_open (int dirfd, const char * name, char follow) {
+    int fd;
+    do {
+	fd = openat (dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (follow ? 0 : O_NOFOLLOW));
+    } while (fd == -1 && errno == EINTR);
+
+    return fd;
+}
+
+/**
+ * Read the next batch of entries of a directory, using a single getdents64 call most of the time
+ * The entries "." and ".." are skipped, the type of the entries whose type is not given by the filesystem is read with fstatat.
+ * @params:
+ *    - fd: the file descriptor of the directory
+ *    - buf: the buffer used by the kernel to write the entries, its size is the size of the batch
+ *    - failed: set to true on failure (the reason is left in errno)
+ * @returns: the entries, an empty array at the end of the directory (the names are allocated by the GC)
+ */
+_yrt_array_ _yrt_dir_read (int fd, _yrt_c8_array_ buf, char * failed) {
+    _yrt_array_ res = {0, NULL};
+    *failed = 0;
+
+    for (;;) {
+	long n = syscall (SYS_getdents64, fd, buf.data, (unsigned int) buf.len);
+	if (n < 0) {
+	    if (errno == EINTR) continue;
+	    *failed = 1;
+	    return res;
+	}
+
+	if (n == 0) return res;
+
+	uint64_t nb = 0, namesLen = 0;
+	for (long pos = 0 ; pos < n ;) {
+	    struct _yrt_linux_dirent64_ * d = (struct _yrt_linux_dirent64_*) (buf.data + pos);
+	    pos += d-> d_reclen;
+	    if (d-> d_name [0] == '.' && (d-> d_name [1] == '\0' || (d-> d_name [1] == '.' && d-> d_name [2] == '\0'))) continue;
+	    nb += 1;
+	    namesLen += strlen (d-> d_name) + 1;
+	}
+
+	if (nb == 0) continue; // the batch only contained . and ..
+
+	_yrt_walk_entry_ * entries = (_yrt_walk_entry_*) GC_malloc (sizeof (_yrt_walk_entry_) * nb);
+	char * names = (char*) GC_malloc (namesLen);
+
+	uint64_t i = 0;
+	for (long pos = 0 ; pos < n ;) {
+	    struct _yrt_linux_dirent64_ * d = (struct _yrt_linux_dirent64_*) (buf.data + pos);
+	    pos += d-> d_reclen;
+	    if (d-> d_name [0] == '.' && (d-> d_name [1] == '\0' || (d-> d_name [1] == '.' && d-> d_name [2] == '\0'))) continue;
+
+	    uint64_t len = strlen (d-> d_name);
+	    memcpy (names, d-> d_name, len + 1); // null terminated, for the *at functions
+	    entries [i].name.len = len;
+	    entries [i].name.data = names;
+	    entries [i].ino = d-> d_ino;
+	    entries [i].type = d-> d_type;
+	    if (d-> d_type == DT_UNKNOWN) { // some filesystems (xfs without ftype, some network fs) do not give the type
+		struct stat st;
+		if (fstatat (fd, names, &st, AT_SYMLINK_NOFOLLOW) == 0) entries [i].type = _yrt_dir_mode_type (st.st_mode);
+	    }
+
+	    names += len + 1;
+	    i += 1;
+	}
+
+	res.len = nb;
+	res.data = entries;
+	return res;
+    }
+}
+
+/**
+ * Get the information of a file relatively to an open directory
+ * @params:
+ *    - follow: if false and name is a link, the information is about the link itself
+ * @returns: 0 on success, -1 on failure (the reason is left in errno)
+ */
+int _yrt_dir_stat (int dirfd, const char * name, char follow, _yrt_entry_stat_ * res) {
+    struct stat st;
+    if (fstatat (dirfd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return -1;
+
+    res-> size = (uint64_t) st.st_size;
+    res-> ino = (uint64_t) st.st_ino;
+    res-> nlink = (uint64_t) st.st_nlink;
+    res-> mtime = (int64_t) st.st_mtim.tv_sec;
+    res-> mtimeNsec = (int64_t) st.st_mtim.tv_nsec;
+    res-> mode = (uint32_t) st.st_mode;
+    res-> uid = (uint32_t) st.st_uid;
+    res-> gid = (uint32_t) st.st_gid;
+    return 0;
+}
+
+/**
+ * Open a file relatively to an open directory
+ * @params:
+ *    - write: if true the file is opened in write only mode (not created, nor truncated)
+ * @returns: the file descriptor, -1 on failure (the reason is left in errno)
+ */
+int _yrt_dir_openat (int dirfd, const char * name, char write) {
+    int fd;
+    do {
+	fd = openat (dirfd, name, (write ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+    } while (fd == -1 && errno == EINTR);
+
+    return fd;
+}
+
+/**
+ * Remove a file, a link, or an empty directory relatively to an open directory
+ * @returns: 0 on success, -1 on failure (the reason is left in errno)
+ */
+int _yrt_dir_unlinkat (int dirfd, const char * name, char dir) {
+    return unlinkat (dirfd, name, dir ? AT_REMOVEDIR : 0);
+}
+
+#endif
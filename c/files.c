@@ -1,5 +1,7 @@
 #ifdef __linux__
 
+#define _GNU_SOURCE // O_CLOEXEC
+
 #include <sys/select.h>
 
 /* According to earlier standards */
@@ -7,6 +9,19 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include "yarray.h"
+
+#ifndef FICLONE
+#define FICLONE _IOW (0x94, 9, int)
+#endif
 
 void _yrt_fd_set (int fd, fd_set * set) {
     FD_SET(fd, set);
@@ -21,4 +36,187 @@ int _yrt_fd_isset (int fd, fd_set * set) {
     return FD_ISSET(fd, set);
 }
 
+/**
+ * Open a file descriptor
+ * @params:
+ *    - path: the null terminated path of the file
+ *    - write: if true the file is opened in write only mode, and created if it does not exist (truncated unless append is set)
+ *    - append: if true, the content of the file is kept (the write offset is chosen by the caller)
+ * @returns: the file descriptor, -1 on failure (the reason is left in errno)
+ */
+int _yrt_fd_open (const char * path, char write, char append) {
+    int flags = O_CLOEXEC;
+    if (write) flags |= O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC);
+    else flags |= O_RDONLY;
+
+    int fd;
+    do {
+	fd = open (path, flags, 0666);
+    } while (fd == -1 && errno == EINTR);
+
+    return fd;
+}
+
+/**
+ * @returns: the size of the file pointed by fd, -1 if it cannot be known
+ */
+int64_t _yrt_fd_size (int fd) {
+    struct stat st;
+    if (fstat (fd, &st) != 0) return -1;
+    return (int64_t) st.st_size;
+}
+
+/**
+ * Read at most len bytes at a given offset of a file
+ * The offset is ignored for the file descriptors that cannot seek (pipes, sockets, terminals), that are read sequentially.
+ * @returns: the number of bytes read, 0 at the end of the file, -1 on failure
+ */
+int64_t _yrt_fd_read_at (int fd, char * buf, uint64_t len, uint64_t offset) {
+    ssize_t n;
+    do {
+	n = pread (fd, buf, len, (off_t) offset);
+	if (n == -1 && errno == ESPIPE) n = read (fd, buf, len);
+    } while (n == -1 && errno == EINTR);
+
+    return (int64_t) n;
+}
+
+/**
+ * Write len bytes at a given offset of a file, retrying the partial writes
+ * The offset is ignored for the file descriptors that cannot seek.
+ * @returns: 0 on success, -1 on failure
+ */
+int _yrt_fd_write_at (int fd, const char * buf, uint64_t len, uint64_t offset) {
+    uint64_t done = 0;
+    while (done < len) {
+	ssize_t n = pwrite (fd, buf + done, len - done, (off_t) (offset + done));
+	if (n == -1 && errno == ESPIPE) n = write (fd, buf + done, len - done);
+	if (n == -1) {
+	    if (errno == EINTR) continue;
+	    return -1;
+	}
+
+	done += (uint64_t) n;
+    }
+
+    return 0;
+}
+
+/**
+ * Find the first occurrence of delim in str
+ * @returns: the index of the occurrence, or str.len if there is none
+ */
+uint64_t _yrt_find_bytes (_yrt_c8_array_ str, _yrt_c8_array_ delim) {
+    if (delim.len == 0) return 0;
+    if (delim.len > str.len) return str.len;
+
+    const char * p = str.data;
+    const char * last = str.data + (str.len - delim.len);
+    while (p <= last) {
+	p = (const char*) memchr (p, delim.data [0], (size_t) (last - p) + 1);
+	if (p == NULL) break;
+	if (memcmp (p, delim.data, delim.len) == 0) return (uint64_t) (p - str.data);
+	p++;
+    }
+
+    return str.len;
+}
+
+/**
+ * Copy the content of a file descriptor into another one, from their current positions
+ * The fastest method supported by the filesystems is used:
+ *    - a reflink (FICLONE), the blocks are shared by the two files until one of them is modified (btrfs, xfs)
+ *    - copy_file_range, the data is copied by the kernel, or by the filesystem itself (nfs, cifs)
+ *    - sendfile, the data is copied by the kernel without going through userspace
+ *    - read/write through a buffer, for the files that cannot be copied otherwise
+ * Each method continues where the previous one stopped, so the copy is complete even if the size of the file is not the one given by stat (e.g. /proc files).
+ * @params:
+ *    - size: the size of the input file
+ * @returns: 0 on success, -1 on failure (the reason is left in errno)
+ */
+static int _yrt_copy_fd (int in, int out, uint64_t size) {
+    if (ioctl (out, FICLONE, in) == 0) return 0;
+
+    uint64_t done = 0;
+#ifdef SYS_copy_file_range
+    while (done < size) {
+	ssize_t n = syscall (SYS_copy_file_range, in, NULL, out, NULL, (size_t) (size - done), 0);
+	if (n == -1 && errno == EINTR) continue;
+	if (n <= 0) break; // not supported (EXDEV, ENOSYS, EINVAL...), the next method continues
+	done += (uint64_t) n;
+    }
+#endif
+
+    while (done < size) {
+	ssize_t n = sendfile (out, in, NULL, (size_t) (size - done < 0x40000000 ? size - done : 0x40000000));
+	if (n == -1 && errno == EINTR) continue;
+	if (n <= 0) break;
+	done += (uint64_t) n;
+    }
+
+    char buf [65536];
+    for (;;) {
+	ssize_t n = read (in, buf, sizeof (buf));
+	if (n == -1) {
+	    if (errno == EINTR) continue;
+	    return -1;
+	}
+
+	if (n == 0) return 0;
+	for (ssize_t w = 0 ; w < n ;) {
+	    ssize_t m = write (out, buf + w, (size_t) (n - w));
+	    if (m == -1) {
+		if (errno == EINTR) continue;
+		return -1;
+	    }
+
+	    w += m;
+	}
+    }
+}
+
+/**
+ * Copy a regular file, the destination is created with the permissions of the source, or truncated if it exists
+ * @params:
+ *    - srcFailed: set to 1 if the failure comes from the source (it cannot be opened, or is not a regular file: EISDIR for a directory, EINVAL otherwise), 0 otherwise
+ * @returns: 0 on success, -1 on failure (the reason is left in errno)
+ */
+int _yrt_copy_file (const char * src, const char * dst, char * srcFailed) {
+    *srcFailed = 1;
+    int in;
+    do {
+	in = open (src, O_RDONLY | O_CLOEXEC);
+    } while (in == -1 && errno == EINTR);
+    if (in == -1) return -1;
+
+    struct stat st;
+    int statOk = fstat (in, &st) == 0;
+    if (!statOk || !S_ISREG (st.st_mode)) {
+	int err = !statOk ? errno : (S_ISDIR (st.st_mode) ? EISDIR : EINVAL);
+	close (in);
+	errno = err;
+	return -1;
+    }
+
+    *srcFailed = 0;
+    int out;
+    do {
+	out = open (dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+    } while (out == -1 && errno == EINTR);
+    if (out == -1) {
+	int err = errno;
+	close (in);
+	errno = err;
+	return -1;
+    }
+
+    int r = _yrt_copy_fd (in, out, (uint64_t) st.st_size);
+    int err = errno;
+    close (in);
+    if (close (out) != 0 && r == 0) return -1;
+
+    errno = err;
+    return r;
+}
+
 #endif
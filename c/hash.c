@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+
+/**
+ * The secret used by the hash function (wyhash), these are the default constants of the reference implementation
+ */
+static const uint64_t _yrt_hash_secret [4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+/**
+ * The seed of the process, randomly chosen at startup so the hash of a value cannot be predicted from outside of the process (hash flooding)
+ * It can be fixed by setting the environment variable YRT_HASH_SEED, to make the iteration order of the hash maps reproducible
+ */
+static uint64_t _yrt_hash_process_seed = 0;
+
+static inline void _yrt_hash_mum (uint64_t * a, uint64_t * b) {
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+}
+
+static inline uint64_t _yrt_hash_wymix (uint64_t a, uint64_t b) {
+    _yrt_hash_mum (&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t _yrt_hash_r8 (const uint8_t * p) {
+    uint64_t v;
+    memcpy (&v, p, 8);
+    return v;
+}
+
+static inline uint64_t _yrt_hash_r4 (const uint8_t * p) {
+    uint32_t v;
+    memcpy (&v, p, 4);
+    return v;
+}
+
+static inline uint64_t _yrt_hash_r3 (const uint8_t * p, uint64_t k) {
+    return (((uint64_t) p [0]) << 16) | (((uint64_t) p [k >> 1]) << 8) | p [k - 1];
+}
+
+__attribute__ ((constructor))
+static void _yrt_hash_init_seed () {
+    const char * env = getenv ("YRT_HASH_SEED");
+    if (env != NULL && env [0] != '\0') {
+	_yrt_hash_process_seed = strtoull (env, NULL, 0);
+	return;
+    }
+
+    uint64_t seed = 0;
+#ifdef __linux__
+    if (getrandom (&seed, sizeof (seed), GRND_NONBLOCK) == sizeof (seed)) {
+	_yrt_hash_process_seed = seed;
+	return;
+    }
+#endif
+
+    // No entropy source available, use the clock, the pid and the address of the seed (ASLR)
+    struct timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    seed = _yrt_hash_wymix ((uint64_t) ts.tv_nsec ^ _yrt_hash_secret [0], (uint64_t) ts.tv_sec ^ (uint64_t) getpid ());
+    _yrt_hash_process_seed = seed ^ (uint64_t) (uintptr_t) &_yrt_hash_process_seed;
+}
+
+/**
+ * @returns: the random seed of the process
+ */
+uint64_t _yrt_hash_seed () {
+    return _yrt_hash_process_seed;
+}
+
+/**
+ * Hash a memory region (wyhash final version 4.2, same results as the reference implementation for the same seed and secret)
+ * Consumes 48 bytes per iteration on three independent lanes, and performs unaligned 8 bytes loads
+ * @params:
+ *    - key: the memory to hash
+ *    - len: the number of bytes to hash
+ *    - seed: the seed of the hash
+ * @returns: the hash of the memory
+ */
+uint64_t _yrt_hash_bytes (const void * key, uint64_t len, uint64_t seed) {
+    const uint8_t * p = (const uint8_t *) key;
+    const uint64_t * s = _yrt_hash_secret;
+    uint64_t a, b;
+
+    seed ^= _yrt_hash_wymix (seed ^ s [0], s [1]);
+    if (len <= 16) {
+	if (len >= 4) {
+	    a = (_yrt_hash_r4 (p) << 32) | _yrt_hash_r4 (p + ((len >> 3) << 2));
+	    b = (_yrt_hash_r4 (p + len - 4) << 32) | _yrt_hash_r4 (p + len - 4 - ((len >> 3) << 2));
+	} else if (len > 0) {
+	    a = _yrt_hash_r3 (p, len);
+	    b = 0;
+	} else {
+	    a = b = 0;
+	}
+    } else {
+	uint64_t i = len;
+	if (i > 48) {
+	    uint64_t see1 = seed, see2 = seed;
+	    do {
+		seed = _yrt_hash_wymix (_yrt_hash_r8 (p) ^ s [1], _yrt_hash_r8 (p + 8) ^ seed);
+		see1 = _yrt_hash_wymix (_yrt_hash_r8 (p + 16) ^ s [2], _yrt_hash_r8 (p + 24) ^ see1);
+		see2 = _yrt_hash_wymix (_yrt_hash_r8 (p + 32) ^ s [3], _yrt_hash_r8 (p + 40) ^ see2);
+		p += 48;
+		i -= 48;
+	    } while (i > 48);
+	    seed ^= see1 ^ see2;
+	}
+
+	while (i > 16) {
+	    seed = _yrt_hash_wymix (_yrt_hash_r8 (p) ^ s [1], _yrt_hash_r8 (p + 8) ^ seed);
+	    i -= 16;
+	    p += 16;
+	}
+
+	a = _yrt_hash_r8 (p + i - 16);
+	b = _yrt_hash_r8 (p + i - 8);
+    }
+
+    a ^= s [1];
+    b ^= seed;
+    _yrt_hash_mum (&a, &b);
+    return _yrt_hash_wymix (a ^ s [0] ^ len, b ^ s [1]);
+}
+
+/**
+ * Transform a pointer into a u64
+ */
+uint64_t _yrt_ptr_to_u64 (void * ptr) {
+    return (uint64_t) (uintptr_t) ptr;
+}
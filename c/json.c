@@ -0,0 +1,361 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "yarray.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#define _YRT_JSON_X86
+#endif
+
+#define _YRT_JSON_NONE 0xffffffffu
+#define _YRT_JSON_EVEN_BITS 0x5555555555555555ull
+
+/**
+ * The classification of a block of 64 bytes of a json content
+ * The bit i of each mask is set iif the byte i of the block is in the class
+ */
+typedef struct {
+    uint64_t quote;     // '"'
+    uint64_t backslash; // '\\'
+    uint64_t op;        // '{', '}', '[', ']', ':', ','
+    uint64_t space;     // ' ', '\t', '\n', '\r'
+} _yrt_json_block_;
+
+static void _yrt_json_classify_scalar (const uint8_t * p, _yrt_json_block_ * b) {
+    b-> quote = 0; b-> backslash = 0; b-> op = 0; b-> space = 0;
+    for (int i = 0 ; i < 64 ; i++) {
+	uint64_t bit = 1ull << i;
+	switch (p [i]) {
+	case '"': b-> quote |= bit; break;
+	case '\\': b-> backslash |= bit; break;
+	case '{': case '}': case '[': case ']': case ':': case ',': b-> op |= bit; break;
+	case ' ': case '\t': case '\n': case '\r': b-> space |= bit; break;
+	default: break;
+	}
+    }
+}
+
+#ifdef _YRT_JSON_X86
+__attribute__ ((target ("sse2")))
+static void _yrt_json_classify_sse2 (const uint8_t * p, _yrt_json_block_ * b) {
+    const __m128i quote = _mm_set1_epi8 ('"');
+    const __m128i backslash = _mm_set1_epi8 ('\\');
+    const __m128i lacc = _mm_set1_epi8 ('{'), racc = _mm_set1_epi8 ('}');
+    const __m128i colon = _mm_set1_epi8 (':'), coma = _mm_set1_epi8 (',');
+    const __m128i space = _mm_set1_epi8 (' '), tab = _mm_set1_epi8 ('\t');
+    const __m128i ret = _mm_set1_epi8 ('\n'), cr = _mm_set1_epi8 ('\r');
+    const __m128i lower = _mm_set1_epi8 (0x20);
+
+    b-> quote = 0; b-> backslash = 0; b-> op = 0; b-> space = 0;
+    for (int i = 0 ; i < 4 ; i++) {
+	__m128i v = _mm_loadu_si128 ((const __m128i*) (p + 16 * i));
+	__m128i l = _mm_or_si128 (v, lower); // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+	__m128i op = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (l, lacc), _mm_cmpeq_epi8 (l, racc)),
+				   _mm_or_si128 (_mm_cmpeq_epi8 (v, colon), _mm_cmpeq_epi8 (v, coma)));
+	__m128i sp = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, space), _mm_cmpeq_epi8 (v, tab)),
+				   _mm_or_si128 (_mm_cmpeq_epi8 (v, ret), _mm_cmpeq_epi8 (v, cr)));
+
+	int shift = 16 * i;
+	b-> quote |= (uint64_t) (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, quote)) << shift;
+	b-> backslash |= (uint64_t) (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, backslash)) << shift;
+	b-> op |= (uint64_t) (uint32_t) _mm_movemask_epi8 (op) << shift;
+	b-> space |= (uint64_t) (uint32_t) _mm_movemask_epi8 (sp) << shift;
+    }
+}
+#endif
+
+/**
+ * @returns: a mask where the bit i is the xor of the bits 0 to i of x
+ */
+static inline uint64_t _yrt_json_prefix_xor (uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/**
+ * Build the structural index of a json content
+ * The content is read by blocks of 64 bytes, which are classified (with sse2 when available) into bit masks.
+ * Escaped characters, and the content of the strings are then found with bit operations on the masks, without branching on the bytes.
+ * The index contains the position of every structural character ('{', '}', '[', ']', ':' and ','), of every opening quote, and of the first byte of every other scalar value (true, false, null, numbers) outside of the strings.
+ * @params:
+ *    - str: the json content (less than 4GiB)
+ *    - index: the array (of u32) to fill with the positions
+ *    - unterminated: set to 1 if the last string of the content is not terminated
+ * @returns: the number of positions of the index, if it is greater than index.len only the index.len first positions are written
+ */
+uint64_t _yrt_json_index (_yrt_c8_array_ str, _yrt_array_ index, uint8_t * unterminated) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    uint32_t * out = (uint32_t*) index.data;
+    uint64_t cap = index.len, nb = 0;
+    uint64_t prevEscaped = 0, prevInString = 0, prevScalar = 0;
+    uint8_t tail [64];
+
+    int simd = 0;
+#ifdef _YRT_JSON_X86
+    simd = __builtin_cpu_supports ("sse2");
+#endif
+
+    for (uint64_t base = 0 ; base < str.len ; base += 64) {
+	const uint8_t * blk = p + base;
+	if (base + 64 > str.len) { // the last block is padded with spaces
+	    memset (tail, ' ', 64);
+	    memcpy (tail, blk, str.len - base);
+	    blk = tail;
+	}
+
+	_yrt_json_block_ b;
+#ifdef _YRT_JSON_X86
+	if (simd) _yrt_json_classify_sse2 (blk, &b);
+	else _yrt_json_classify_scalar (blk, &b);
+#else
+	(void) simd;
+	_yrt_json_classify_scalar (blk, &b);
+#endif
+
+	// A character is escaped if it follows an odd sequence of backslashes
+	uint64_t bs = b.backslash & ~prevEscaped;
+	uint64_t followsEscape = (bs << 1) | prevEscaped;
+	uint64_t oddStarts = bs & ~_YRT_JSON_EVEN_BITS & ~followsEscape;
+	uint64_t evenStarts;
+	prevEscaped = __builtin_add_overflow (oddStarts, bs, &evenStarts);
+	uint64_t escaped = (_YRT_JSON_EVEN_BITS ^ (evenStarts << 1)) & followsEscape;
+
+	// The bytes between an opening quote (included) and a closing quote (excluded) are inside a string
+	uint64_t quote = b.quote & ~escaped;
+	uint64_t inString = _yrt_json_prefix_xor (quote) ^ prevInString;
+	prevInString = (uint64_t) ((int64_t) inString >> 63);
+
+	uint64_t scalar = ~(b.op | b.space | b.quote) & ~inString;
+	uint64_t scalarStart = scalar & ~((scalar << 1) | prevScalar);
+	prevScalar = scalar >> 63;
+
+	uint64_t all = (b.op & ~inString) | (quote & inString) | scalarStart;
+	while (all != 0) {
+	    if (nb < cap) out [nb] = (uint32_t) (base + (uint64_t) __builtin_ctzll (all));
+	    nb += 1;
+	    all &= all - 1;
+	}
+    }
+
+    *unterminated = prevInString != 0;
+    return nb;
+}
+
+/**
+ * Link the brackets of a structural index to their matching bracket
+ * The stack of the opened brackets is chained through the jumps array itself, so no memory is allocated.
+ * @params:
+ *    - str: the json content
+ *    - index: the structural index of str
+ *    - jumps: the array (of u32, same length as index) to fill, the entry of each bracket is set to the position in index of its matching bracket
+ * @returns: index.len if the brackets are balanced, the position in index of the first unbalanced bracket otherwise
+ */
+uint64_t _yrt_json_link (_yrt_c8_array_ str, _yrt_array_ index, _yrt_array_ jumps) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    const uint32_t * idx = (const uint32_t*) index.data;
+    uint32_t * jmp = (uint32_t*) jumps.data;
+    uint32_t top = _YRT_JSON_NONE;
+
+    for (uint64_t i = 0 ; i < index.len ; i++) {
+	uint8_t c = p [idx [i]];
+	if (c == '{' || c == '[') {
+	    jmp [i] = top;
+	    top = (uint32_t) i;
+	} else if (c == '}' || c == ']') {
+	    // '{' + 2 == '}' and '[' + 2 == ']'
+	    if (top == _YRT_JSON_NONE || p [idx [top]] + 2 != c) return i;
+	    uint32_t prev = jmp [top];
+	    jmp [top] = (uint32_t) i;
+	    jmp [i] = top;
+	    top = prev;
+	}
+    }
+
+    if (top != _YRT_JSON_NONE) return top;
+    return index.len;
+}
+
+/**
+ * Find the closing quote of a string
+ * @params:
+ *    - str: the json content
+ *    - from: the position of the first byte of the string content (just after the opening quote)
+ *    - hasEscape: set to 1 if the string contains escape sequences
+ * @returns: the position of the closing quote, str.len if there is none
+ */
+uint64_t _yrt_json_string_end (_yrt_c8_array_ str, uint64_t from, uint8_t * hasEscape) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    *hasEscape = 0;
+    uint64_t i = from;
+    while (i < str.len) {
+	const uint8_t * q = (const uint8_t*) memchr (p + i, '"', str.len - i);
+	if (q == NULL) return str.len;
+
+	uint64_t end = (uint64_t) (q - p);
+	if (!*hasEscape && memchr (p + i, '\\', end - i) != NULL) *hasEscape = 1;
+
+	uint64_t nb = 0;
+	while (end - nb > from && p [end - nb - 1] == '\\') nb += 1;
+	if ((nb & 1) == 0) return end;
+
+	i = end + 1;
+    }
+
+    return str.len;
+}
+
+static int _yrt_json_hex4 (const uint8_t * p, uint32_t * res) {
+    uint32_t r = 0;
+    for (int i = 0 ; i < 4 ; i++) {
+	uint8_t c = p [i];
+	r <<= 4;
+	if (c >= '0' && c <= '9') r |= (uint32_t) (c - '0');
+	else if (c >= 'a' && c <= 'f') r |= (uint32_t) (c - 'a' + 10);
+	else if (c >= 'A' && c <= 'F') r |= (uint32_t) (c - 'A' + 10);
+	else return 0;
+    }
+
+    *res = r;
+    return 1;
+}
+
+/**
+ * Resolve the escape sequences of the content of a json string
+ * An escape sequence never takes less bytes than the character it encodes, so out can be as long as str.
+ * @params:
+ *    - str: the content of the string (without the quotes)
+ *    - out: the buffer to fill (at least str.len bytes)
+ * @returns: the number of bytes written in out, or the position in str of the invalid escape sequence + str.len + 1 if the string is invalid
+ */
+uint64_t _yrt_json_unescape (_yrt_c8_array_ str, _yrt_c8_array_ out) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    uint8_t * o = (uint8_t*) out.data;
+    uint64_t i = 0, n = 0;
+    while (i < str.len) {
+	const uint8_t * q = (const uint8_t*) memchr (p + i, '\\', str.len - i);
+	uint64_t end = q == NULL ? str.len : (uint64_t) (q - p);
+	memcpy (o + n, p + i, end - i);
+	n += end - i;
+	if (q == NULL) break;
+
+	uint64_t at = end;
+	if (end + 1 >= str.len) return str.len + 1 + at;
+	switch (p [end + 1]) {
+	case '"': o [n++] = '"'; break;
+	case '\\': o [n++] = '\\'; break;
+	case '/': o [n++] = '/'; break;
+	case 'b': o [n++] = '\b'; break;
+	case 'f': o [n++] = '\f'; break;
+	case 'n': o [n++] = '\n'; break;
+	case 'r': o [n++] = '\r'; break;
+	case 't': o [n++] = '\t'; break;
+	case 'u': {
+	    uint32_t c;
+	    if (end + 6 > str.len || !_yrt_json_hex4 (p + end + 2, &c)) return str.len + 1 + at;
+	    end += 4;
+	    if (c >= 0xd800 && c <= 0xdbff) { // high surrogate, must be followed by a low one
+		uint32_t lo;
+		if (end + 8 > str.len || p [end + 2] != '\\' || p [end + 3] != 'u' || !_yrt_json_hex4 (p + end + 4, &lo)) return str.len + 1 + at;
+		if (lo < 0xdc00 || lo > 0xdfff) return str.len + 1 + at;
+		c = 0x10000 + ((c - 0xd800) << 10) + (lo - 0xdc00);
+		end += 6;
+	    } else if (c >= 0xdc00 && c <= 0xdfff) return str.len + 1 + at;
+
+	    if (c < 0x80) o [n++] = (uint8_t) c;
+	    else if (c < 0x800) {
+		o [n++] = (uint8_t) (0xc0 | (c >> 6));
+		o [n++] = (uint8_t) (0x80 | (c & 0x3f));
+	    } else if (c < 0x10000) {
+		o [n++] = (uint8_t) (0xe0 | (c >> 12));
+		o [n++] = (uint8_t) (0x80 | ((c >> 6) & 0x3f));
+		o [n++] = (uint8_t) (0x80 | (c & 0x3f));
+	    } else {
+		o [n++] = (uint8_t) (0xf0 | (c >> 18));
+		o [n++] = (uint8_t) (0x80 | ((c >> 12) & 0x3f));
+		o [n++] = (uint8_t) (0x80 | ((c >> 6) & 0x3f));
+		o [n++] = (uint8_t) (0x80 | (c & 0x3f));
+	    }
+	} break;
+	default: return str.len + 1 + at;
+	}
+
+	i = end + 2;
+    }
+
+    return n;
+}
+
+// defined in conv.c
+size_t _yrt_parse_double (const char * p, size_t len, double * out);
+
+#define _YRT_JSON_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/**
+ * Parse a json number at the beginning of a string
+ * The integers that fit in an i64 are read directly.
+ * The other numbers are converted by the length bounded float parser of conv.c.
+ * @params:
+ *    - str: the string starting with the number
+ *    - i: set to the value of the number if it is an integer that fits in an i64
+ *    - f: set to the value of the number otherwise
+ *    - isFloat: set to 1 if the value is stored in f, 0 if it is stored in i
+ * @returns: the length of the number, 0 if str does not start with a valid json number
+ */
+uint64_t _yrt_json_number (_yrt_c8_array_ str, int64_t * i, double * f, uint8_t * isFloat) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    uint64_t len = str.len, k = 0;
+
+    int neg = 0;
+    if (k < len && p [k] == '-') { neg = 1; k++; }
+    if (k >= len || !_YRT_JSON_DIGIT (p [k])) return 0;
+
+    uint64_t m = 0;
+    int nbDigits = 0, overflow = 0;
+
+    if (p [k] == '0') k++; // no leading zeros
+    else {
+	for (; k < len && _YRT_JSON_DIGIT (p [k]) ; k++) {
+	    if (nbDigits < 19) { m = m * 10 + (uint64_t) (p [k] - '0'); nbDigits++; }
+	    else overflow = 1;
+	}
+    }
+
+    int floating = 0;
+    if (k < len && p [k] == '.') {
+	k++;
+	uint64_t start = k;
+	while (k < len && _YRT_JSON_DIGIT (p [k])) k++;
+	if (k == start) return 0;
+	floating = 1;
+    }
+
+    if (k < len && (p [k] == 'e' || p [k] == 'E')) {
+	k++;
+	if (k < len && (p [k] == '+' || p [k] == '-')) k++;
+
+	uint64_t start = k;
+	while (k < len && _YRT_JSON_DIGIT (p [k])) k++;
+	if (k == start) return 0;
+	floating = 1;
+    }
+
+    if (!floating && !overflow) {
+	if (!neg && m <= (uint64_t) INT64_MAX) {
+	    *i = (int64_t) m; *isFloat = 0;
+	    return k;
+	} else if (neg && m <= (uint64_t) INT64_MAX + 1) {
+	    *i = (int64_t) (0 - m); *isFloat = 0;
+	    return k;
+	}
+    }
+
+    *isFloat = 1;
+    if (_yrt_parse_double ((const char*) p, k, f) != k) return 0; // the number was validated above, it must be read entirely
+    return k;
+}
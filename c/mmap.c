@@ -0,0 +1,99 @@
+#ifdef __linux__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include "yarray.h"
+
+/**
+ * Map the content of a file in memory
+ * @params:
+ *    - path: the null terminated path of the file
+ *    - write: if true the file is opened in read/write mode and the mapping is shared, so writing in the memory writes in the file
+ *    - succ: set to 1 on success, 0 otherwise (the reason is left in errno)
+ * @returns: the mapped memory, an empty array if the file is empty
+ * @info: the file descriptor is closed before returning, the mapping remains valid until it is unmapped by _yrt_munmap
+ */
+_yrt_c8_array_ _yrt_mmap_file (const char * path, char write, char * succ) {
+    _yrt_c8_array_ res = { 0, NULL };
+    *succ = 0;
+
+    int fd;
+    do {
+	fd = open (path, (write ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    } while (fd == -1 && errno == EINTR);
+    if (fd == -1) return res;
+
+    struct stat st;
+    if (fstat (fd, &st) != 0) {
+	int err = errno;
+	close (fd);
+	errno = err;
+	return res;
+    }
+
+    if (!S_ISREG (st.st_mode)) {
+	close (fd);
+	errno = EISDIR;
+	return res;
+    }
+
+    if (st.st_size != 0) { // mapping an empty range is an error
+	int prot = write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void * data = mmap (NULL, (size_t) st.st_size, prot, write ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+	    int err = errno;
+	    close (fd);
+	    errno = err;
+	    return res;
+	}
+
+	res.len = (uint64_t) st.st_size;
+	res.data = (char*) data;
+    }
+
+    close (fd);
+    *succ = 1;
+    return res;
+}
+
+/**
+ * Unmap a memory mapped by _yrt_mmap_file
+ */
+void _yrt_munmap (_yrt_c8_array_ content) {
+    if (content.len != 0) munmap (content.data, content.len);
+}
+
+/**
+ * Give a hint to the kernel about the way the mapped memory will be accessed
+ * @params:
+ *    - advice: 0 normal, 1 random, 2 sequential, 3 willneed, 4 dontneed
+ * @returns: 0 on success, -1 otherwise
+ */
+int _yrt_madvise (_yrt_c8_array_ content, int advice) {
+    static const int advices [] = { MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED, MADV_DONTNEED };
+    if (content.len == 0) return 0;
+    if (advice < 0 || advice > 4) {
+	errno = EINVAL;
+	return -1;
+    }
+
+    return madvise (content.data, content.len, advices [advice]);
+}
+
+/**
+ * Write the modifications made to a shared mapping to the file
+ * @params:
+ *    - wait: if true, wait for the writing to be complete (MS_SYNC), otherwise only schedule it (MS_ASYNC)
+ * @returns: 0 on success, -1 otherwise
+ */
+int _yrt_msync (_yrt_c8_array_ content, char wait) {
+    if (content.len == 0) return 0;
+    return msync (content.data, content.len, wait ? MS_SYNC : MS_ASYNC);
+}
+
+#endif
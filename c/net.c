@@ -0,0 +1,111 @@
+#ifdef __linux__
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <errno.h>
+#include "yarray.h"
+
+/**
+ * The maximal number of datagrams transfered by a single recvmmsg/sendmmsg call
+ * The headers are allocated on the stack
+ */
+#define _YRT_MMSG_BATCH 256
+
+/**
+ * Receive multiple datagrams from a udp socket in a single system call
+ * @params:
+ *    - fd: the file descriptor of the socket
+ *    - buffers: a [[mut u8]], each received datagram is written in the buffer of the same index
+ *    - lens: a [mut usize], filled with the size of each received datagram
+ *    - addrs: a [mut sockaddr_in6], filled with the address of the sender of each datagram (can be empty)
+ *    - flags: the flags passed to recvmmsg
+ * @returns: the number of received datagrams, -1 on error (errno is set)
+ */
+int _yrt_udp_recv_batch (int fd, _yrt_array_ buffers, _yrt_array_ lens, _yrt_array_ addrs, int flags) {
+    _yrt_array_ * bufs = (_yrt_array_*) buffers.data;
+    unsigned long * sizes = (unsigned long*) lens.data;
+    struct sockaddr_in6 * names = (struct sockaddr_in6*) addrs.data;
+
+    unsigned long nb = buffers.len;
+    if (lens.len < nb) nb = lens.len;
+    if (addrs.len != 0 && addrs.len < nb) nb = addrs.len;
+    if (nb > _YRT_MMSG_BATCH) nb = _YRT_MMSG_BATCH;
+    if (nb == 0) return 0;
+
+    struct mmsghdr msgs [_YRT_MMSG_BATCH];
+    struct iovec iovecs [_YRT_MMSG_BATCH];
+    memset (msgs, 0, nb * sizeof (struct mmsghdr));
+
+    for (unsigned long i = 0 ; i < nb ; i++) {
+	iovecs [i].iov_base = bufs [i].data;
+	iovecs [i].iov_len = bufs [i].len;
+	msgs [i].msg_hdr.msg_iov = &iovecs [i];
+	msgs [i].msg_hdr.msg_iovlen = 1;
+	if (addrs.len != 0) {
+	    msgs [i].msg_hdr.msg_name = &names [i];
+	    msgs [i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in6);
+	}
+    }
+
+    int res;
+    do {
+	res = recvmmsg (fd, msgs, nb, flags, NULL);
+    } while (res == -1 && errno == EINTR);
+
+    for (int i = 0 ; i < res ; i++) {
+	sizes [i] = msgs [i].msg_len;
+    }
+
+    return res;
+}
+
+/**
+ * Send multiple datagrams through a udp socket in a single system call
+ * @params:
+ *    - fd: the file descriptor of the socket
+ *    - buffers: a [[u8]], each slice is sent as a datagram
+ *    - addrs: a [sockaddr_in6] containing the destination of each datagram (sockaddr_in are stored in the same memory), reused cyclically if shorter than buffers (a single address sends every datagram to the same destination), or an empty slice if the socket is connected
+ *    - flags: the flags passed to sendmmsg
+ * @returns: the number of sent datagrams, -1 on error if nothing was sent (errno is set)
+ */
+int _yrt_udp_send_batch (int fd, _yrt_array_ buffers, _yrt_array_ addrs, int flags) {
+    _yrt_array_ * bufs = (_yrt_array_*) buffers.data;
+    struct sockaddr_in6 * names = (struct sockaddr_in6*) addrs.data;
+
+    struct mmsghdr msgs [_YRT_MMSG_BATCH];
+    struct iovec iovecs [_YRT_MMSG_BATCH];
+
+    unsigned long sent = 0;
+    while (sent < buffers.len) {
+	unsigned long nb = buffers.len - sent;
+	if (nb > _YRT_MMSG_BATCH) nb = _YRT_MMSG_BATCH;
+	memset (msgs, 0, nb * sizeof (struct mmsghdr));
+
+	for (unsigned long i = 0 ; i < nb ; i++) {
+	    iovecs [i].iov_base = bufs [sent + i].data;
+	    iovecs [i].iov_len = bufs [sent + i].len;
+	    msgs [i].msg_hdr.msg_iov = &iovecs [i];
+	    msgs [i].msg_hdr.msg_iovlen = 1;
+	    if (addrs.len != 0) {
+		struct sockaddr_in6 * name = &names [(sent + i) % addrs.len];
+		msgs [i].msg_hdr.msg_name = name;
+		msgs [i].msg_hdr.msg_namelen = (name-> sin6_family == AF_INET) ? sizeof (struct sockaddr_in) : sizeof (struct sockaddr_in6);
+	    }
+	}
+
+	int res = sendmmsg (fd, msgs, nb, flags);
+	if (res == -1) {
+	    if (errno == EINTR) continue;
+	    return sent == 0 ? -1 : (int) sent;
+	}
+
+	sent += res;
+    }
+
+    return (int) sent;
+}
+
+#endif
@@ -1,35 +1,16 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "print.h"
+#include "utf8.h"
 #include "yarray.h"
 #include "gc.h"
 
 typedef unsigned int uint;
 
-_yrt_c8_array_ _yrt_to_utf8_array (_yrt_c32_array_ array) {
-    unsigned long len = 0;
-    for (unsigned long i = 0 ; i < array.len ; i++) {
-	int nb = 0;
-	char buf[5];
-	_yrt_to_utf8 (array.data [i], buf, &nb);
-	len += nb;
-    }
-
-    char* result = GC_malloc (len * sizeof (char) + 1);
-    int offset = 0;
-    for (unsigned long i = 0 ; i < array.len; i++) {
-	int nb = 0;
-	_yrt_to_utf8 (array.data [i], result + offset, &nb);
-	offset += nb;
-    }
-
-    _yrt_c8_array_ arr;
-    arr.data = result;
-    arr.len = len;
-    
-    return arr;
-}
-
 char* _yrt_to_utf8 (unsigned int code, char chars[5], int * nb) {
     if (code <= 0x7F) {
 	chars[0] = (code & 0x7F); chars[1] = '\0';
@@ -55,7 +36,7 @@ char* _yrt_to_utf8 (unsigned int code, char chars[5], int * nb) {
 	*nb = 4;
     } else {
 	// unicode replacement character
-	chars[2] = 0xEF; chars[1] = 0xBF; chars[0] = 0xBD;
+	chars[0] = 0xEF; chars[1] = 0xBF; chars[2] = 0xBD;
 	chars[3] = '\0';
 	*nb = 3;
     }
@@ -113,120 +94,364 @@ unsigned int _yrt_to_utf32 (char* text, size_t * byte_count) {
 }
 
 
-_yrt_c32_array_ _yrt_to_utf32_array (_yrt_c8_array_ array) {
-    unsigned long len = 0;
-    for (unsigned long i = 0 ; i < array.len ;) {
-	size_t nb = 0;
-	_yrt_to_utf32 (array.data + i, &nb);
-	i += nb;
-	len += 1;
+/**
+ * Output writers
+ * ==============
+ * Every print function of std::io writes to stdout (fd = 1) or stderr (fd = 2) through the following functions.
+ * The data are written in bulk to the stdio FILE, whose buffering mode can be changed with _yrt_out_set_mode.
+ * When thread buffering is enabled, each thread accumulates its output in its own buffer, that is given to the FILE one complete line at a time (so concurrent println do not interleave, and the FILE lock is taken once per line instead of once per printed element).
+ */
+
+#define _YRT_OUT_TLS_SIZE 4096
+
+/**
+ * The output buffers of a thread
+ * A buffer grows when a line does not fit in it, so a line is always given to the FILE in one fwrite, and is never mixed with the output of another thread.
+ * The buffers of every thread are registered in a list, so they can all be flushed at exit, or when thread buffering is disabled.
+ */
+typedef struct _yrt_out_tls_ {
+    pthread_mutex_t lock; // taken by the owner when it writes, and by the thread flushing every buffer
+    struct _yrt_out_tls_ * prev;
+    struct _yrt_out_tls_ * next;
+    size_t len [2];
+    size_t cap [2];
+    char * data [2];
+    char init [2][_YRT_OUT_TLS_SIZE];
+} _yrt_out_tls_;
+
+static int __yrt_out_thread_buffered__ = 0;
+
+static pthread_key_t __yrt_out_key__;
+
+static pthread_once_t __yrt_out_once__ = PTHREAD_ONCE_INIT;
+
+static __thread _yrt_out_tls_ * __yrt_out_tls__ = NULL;
+
+static pthread_mutex_t __yrt_out_registry_lock__ = PTHREAD_MUTEX_INITIALIZER;
+
+static _yrt_out_tls_ * __yrt_out_registry__ = NULL;
+
+static FILE * _yrt_out_file (int fd) {
+    return (fd == 2) ? stderr : stdout;
+}
+
+/**
+ * Give the content of the buffers to the FILE (tls-> lock must be held)
+ */
+static void _yrt_out_flush_tls (_yrt_out_tls_ * tls) {
+    for (int i = 0 ; i < 2 ; i++) {
+	if (tls-> len [i] != 0) {
+	    fwrite (tls-> data [i], 1, tls-> len [i], _yrt_out_file (i + 1));
+	    tls-> len [i] = 0;
+	}
+
+	if (tls-> data [i] != tls-> init [i]) { // a long line made the buffer grow, it is not kept
+	    free (tls-> data [i]);
+	    tls-> data [i] = tls-> init [i];
+	    tls-> cap [i] = _YRT_OUT_TLS_SIZE;
+	}
+    }
+}
+
+static void _yrt_out_unregister (_yrt_out_tls_ * tls) {
+    pthread_mutex_lock (&__yrt_out_registry_lock__);
+    if (tls-> prev != NULL) tls-> prev-> next = tls-> next;
+    else __yrt_out_registry__ = tls-> next;
+    if (tls-> next != NULL) tls-> next-> prev = tls-> prev;
+    pthread_mutex_unlock (&__yrt_out_registry_lock__);
+}
+
+static void _yrt_out_tls_destroy (void * data) {
+    _yrt_out_tls_ * tls = (_yrt_out_tls_*) data;
+    _yrt_out_unregister (tls);
+
+    pthread_mutex_lock (&tls-> lock);
+    _yrt_out_flush_tls (tls);
+    pthread_mutex_unlock (&tls-> lock);
+
+    pthread_mutex_destroy (&tls-> lock);
+    free (tls);
+}
+
+/**
+ * Flush the buffers of every thread
+ */
+static void _yrt_out_flush_all () {
+    pthread_mutex_lock (&__yrt_out_registry_lock__);
+    for (_yrt_out_tls_ * tls = __yrt_out_registry__ ; tls != NULL ; tls = tls-> next) {
+	pthread_mutex_lock (&tls-> lock);
+	_yrt_out_flush_tls (tls);
+	pthread_mutex_unlock (&tls-> lock);
     }
+    pthread_mutex_unlock (&__yrt_out_registry_lock__);
+}
 
-    unsigned int * result = GC_malloc ((len + 1) * sizeof (unsigned int));
-    int offset = 0;
-    int j = 0;
-    for (unsigned long i = 0 ; i < array.len ;) {
-	size_t nb = 0;
-	result [j] = _yrt_to_utf32 (array.data + i, &nb);
-	i += nb;
-	j += 1;
+static void _yrt_out_exit () {
+    _yrt_out_flush_all ();
+}
+
+static void _yrt_out_init () {
+    pthread_key_create (&__yrt_out_key__, &_yrt_out_tls_destroy);
+    atexit (&_yrt_out_exit);
+}
+
+/**
+ * @returns: the buffers of the current thread, NULL if they could not be allocated
+ */
+static _yrt_out_tls_ * _yrt_out_get_tls () {
+    if (__yrt_out_tls__ == NULL) {
+	pthread_once (&__yrt_out_once__, &_yrt_out_init);
+	// Allocated with malloc, the buffer does not contain any pointer to the GC heap and must survive until the thread destructor
+	_yrt_out_tls_ * tls = (_yrt_out_tls_*) malloc (sizeof (_yrt_out_tls_));
+	if (tls == NULL) return NULL;
+
+	pthread_mutex_init (&tls-> lock, NULL);
+	for (int i = 0 ; i < 2 ; i++) {
+	    tls-> len [i] = 0;
+	    tls-> cap [i] = _YRT_OUT_TLS_SIZE;
+	    tls-> data [i] = tls-> init [i];
+	}
+
+	pthread_mutex_lock (&__yrt_out_registry_lock__);
+	tls-> prev = NULL;
+	tls-> next = __yrt_out_registry__;
+	if (__yrt_out_registry__ != NULL) __yrt_out_registry__-> prev = tls;
+	__yrt_out_registry__ = tls;
+	pthread_mutex_unlock (&__yrt_out_registry_lock__);
+
+	__yrt_out_tls__ = tls;
+	pthread_setspecific (__yrt_out_key__, tls);
     }
 
-    _yrt_c32_array_ arr;
-    arr.data = result;
-    arr.len = len;
-    return arr;
+    return __yrt_out_tls__;
+}
+
+/**
+ * Make sure the buffer i can store size bytes (tls-> lock must be held)
+ * @returns: 0 if the buffer could not grow
+ */
+static int _yrt_out_reserve (_yrt_out_tls_ * tls, int i, size_t size) {
+    if (size <= tls-> cap [i]) return 1;
+
+    size_t cap = tls-> cap [i] * 2;
+    while (cap < size) cap *= 2;
+
+    char * data = (char*) malloc (cap);
+    if (data == NULL) return 0;
+
+    memcpy (data, tls-> data [i], tls-> len [i]);
+    if (tls-> data [i] != tls-> init [i]) free (tls-> data [i]);
+    tls-> data [i] = data;
+    tls-> cap [i] = cap;
+    return 1;
+}
+
+void _yrt_out_write_ptr (int fd, const char * data, size_t len) {
+    if (len == 0) return;
+    _yrt_out_tls_ * tls = NULL;
+    if (__atomic_load_n (&__yrt_out_thread_buffered__, __ATOMIC_RELAXED) || __yrt_out_tls__ != NULL) {
+	tls = _yrt_out_get_tls ();
+    }
+
+    if (tls == NULL) { // no thread buffering (or no memory for it)
+	fwrite (data, 1, len, _yrt_out_file (fd));
+	return;
+    }
+
+    int i = (fd == 2) ? 1 : 0;
+    pthread_mutex_lock (&tls-> lock);
+    if (!_yrt_out_reserve (tls, i, tls-> len [i] + len)) {
+	// Out of memory, the line cannot be kept whole
+	_yrt_out_flush_tls (tls);
+	fwrite (data, 1, len, _yrt_out_file (fd));
+    } else {
+	size_t old = tls-> len [i];
+	memcpy (tls-> data [i] + old, data, len);
+	tls-> len [i] += len;
+
+	// Only complete lines are given to the FILE, the end of the line is kept for the next print
+	// The pending bytes contain no '\n', so only the appended ones are scanned
+	size_t n = old + len;
+	while (n != old && tls-> data [i][n - 1] != '\n') n -= 1;
+	if (n != old) {
+	    fwrite (tls-> data [i], 1, n, _yrt_out_file (fd));
+	    memmove (tls-> data [i], tls-> data [i] + n, tls-> len [i] - n);
+	    tls-> len [i] -= n;
+	}
+    }
+
+    int release = !__atomic_load_n (&__yrt_out_thread_buffered__, __ATOMIC_RELAXED) && tls-> len [0] == 0 && tls-> len [1] == 0;
+    pthread_mutex_unlock (&tls-> lock);
+
+    if (release) { // thread buffering was disabled, back to the direct path
+	__yrt_out_tls__ = NULL;
+	pthread_setspecific (__yrt_out_key__, NULL);
+	_yrt_out_tls_destroy (tls);
+    }
+}
+
+void _yrt_out_write (int fd, _yrt_c8_array_ str) {
+    _yrt_out_write_ptr (fd, str.data, str.len);
+}
+
+void _yrt_out_putc (int fd, char c) {
+    _yrt_out_write_ptr (fd, &c, 1);
+}
+
+void _yrt_out_write_utf32 (int fd, _yrt_c32_array_ str) {
+    char buf [1024 * 4 + 1];
+    const uint32_t * src = (const uint32_t*) str.data;
+    for (size_t i = 0 ; i < str.len ; i += 1024) {
+	size_t n = (str.len - i < 1024) ? (str.len - i) : 1024;
+	_yrt_out_write_ptr (fd, buf, _yrt_utf32_to_utf8 (src + i, n, buf));
+    }
+}
+
+void _yrt_out_printf (int fd, const char * format, ...) {
+    char buf [128];
+    va_list args;
+    va_start (args, format);
+    int n = vsnprintf (buf, sizeof (buf), format, args);
+    va_end (args);
+
+    if (n < 0) return;
+    if ((size_t) n < sizeof (buf)) {
+	_yrt_out_write_ptr (fd, buf, n);
+    } else {
+	char * big = malloc (n + 1);
+	if (big == NULL) { // the output is truncated rather than lost
+	    _yrt_out_write_ptr (fd, buf, sizeof (buf) - 1);
+	    return;
+	}
+
+	va_start (args, format);
+	vsnprintf (big, n + 1, format, args);
+	va_end (args);
+	
+	_yrt_out_write_ptr (fd, big, n);
+	free (big);
+    }
+}
+
+void _yrt_out_flush (int fd) {
+    _yrt_out_tls_ * tls = __yrt_out_tls__;
+    if (tls != NULL) {
+	int i = (fd == 2) ? 1 : 0;
+	pthread_mutex_lock (&tls-> lock);
+	if (tls-> len [i] != 0) {
+	    fwrite (tls-> data [i], 1, tls-> len [i], _yrt_out_file (fd));
+	    tls-> len [i] = 0;
+	}
+	pthread_mutex_unlock (&tls-> lock);
+    }
+
+    fflush (_yrt_out_file (fd));
+}
+
+void _yrt_out_set_mode (int fd, int mode) {
+    FILE * file = _yrt_out_file (fd);
+    fflush (file);
+    switch (mode) {
+    case 0 : setvbuf (file, NULL, _IONBF, 0); break;
+    case 1 : setvbuf (file, NULL, _IOLBF, BUFSIZ); break;
+    default : setvbuf (file, NULL, _IOFBF, 1 << 16); break;
+    }
+}
+
+void _yrt_out_set_thread_buffered (unsigned char enable) {
+    __atomic_store_n (&__yrt_out_thread_buffered__, enable ? 1 : 0, __ATOMIC_RELAXED);
+    if (!enable) _yrt_out_flush_all (); // the buffers of the other threads are released by their next print
 }
 
 void _yrt_putwchar (unsigned int code) {
     char c[5];
     int nb = 0;
-    printf ("%s", _yrt_to_utf8 (code, c, &nb));    
+    _yrt_out_write_ptr (1, _yrt_to_utf8 (code, c, &nb), nb);
 }
 
 void _yrt_eputwchar (unsigned int code) {
     char c[5];
     int nb = 0;
-    fprintf (stderr, "%s", _yrt_to_utf8 (code, c, &nb));    
+    _yrt_out_write_ptr (2, _yrt_to_utf8 (code, c, &nb), nb);
 }
 
 void _yrt_printf32 (float x) {
     if (x > 1.e6f || x < -1.e6f) {
-        printf ("%e", x);
+        _yrt_out_printf (1, "%e", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        printf ("%e", x);
+        _yrt_out_printf (1, "%e", x);
     } else
-        printf ("%.6g", x);
+        _yrt_out_printf (1, "%.6g", x);
 }
 
 void _yrt_printf64 (double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        printf ("%le", x);
+        _yrt_out_printf (1, "%le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        printf ("%le", x);
+        _yrt_out_printf (1, "%le", x);
     } else {
-        printf ("%.6lg", x);
+        _yrt_out_printf (1, "%.6lg", x);
     }
 }
 
 void _yrt_printf80 (long double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        printf ("%Le", x);
+        _yrt_out_printf (1, "%Le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        printf ("%Le", x);
+        _yrt_out_printf (1, "%Le", x);
     } else {
-        printf ("%.6Lg", x);
+        _yrt_out_printf (1, "%.6Lg", x);
     }
 }
 
 
 void _yrt_printfsize (long double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        printf ("%Le", x);
+        _yrt_out_printf (1, "%Le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        printf ("%Le", x);
+        _yrt_out_printf (1, "%Le", x);
     } else {
-        printf ("%.6Lg", x);
+        _yrt_out_printf (1, "%.6Lg", x);
     }
 }
 
 
 void _yrt_eprintf32 (float x) {
     if (x > 1.e6f || x < -1.e6f) {
-        fprintf (stderr, "%e", x);
+        _yrt_out_printf (2, "%e", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        fprintf (stderr, "%e", x);
+        _yrt_out_printf (2, "%e", x);
     } else
-        fprintf (stderr, "%.6g", x);
+        _yrt_out_printf (2, "%.6g", x);
 }
 
 void _yrt_eprintf64 (double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        fprintf (stderr, "%le", x);
+        _yrt_out_printf (2, "%le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        fprintf (stderr, "%le", x);
+        _yrt_out_printf (2, "%le", x);
     } else {
-        fprintf (stderr, "%.6lg", x);
+        _yrt_out_printf (2, "%.6lg", x);
     }
 }
 
 void _yrt_eprintf80 (long double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        fprintf (stderr, "%Le", x);
+        _yrt_out_printf (2, "%Le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        fprintf (stderr, "%Le", x);
+        _yrt_out_printf (2, "%Le", x);
     } else {
-        fprintf (stderr, "%.6Lg", x);
+        _yrt_out_printf (2, "%.6Lg", x);
     }
 }
 
 void _yrt_eprintfsize (long double x) {
     if (x > 1.e6f || x < -1.e6f) {
-        fprintf (stderr, "%Le", x);
+        _yrt_out_printf (2, "%Le", x);
     } else if (x < 1.e-6f && x > -1.e-6f) {
-        fprintf (stderr, "%Le", x);
+        _yrt_out_printf (2, "%Le", x);
     } else {
-        fprintf (stderr, "%.6Lg", x);
+        _yrt_out_printf (2, "%.6Lg", x);
     }
 }
 
@@ -281,5 +506,5 @@ unsigned int _yrt_getwchar_in_file (FILE * file) {
 }
 
 void _yrt_fflush_stdout () {
-    fflush (stdout);
+    _yrt_out_flush (1);
 }
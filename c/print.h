@@ -12,6 +12,21 @@ char * _yrt_to_utf8 (unsigned int code, char chars [5], int* nb);
  */
 unsigned int _yrt_to_utf32 (char* text, size_t * byte_count);
 
+/**
+ * Write len bytes to stdout (fd = 1) or stderr (fd = 2) through the buffered writers
+ */
+void _yrt_out_write_ptr (int fd, const char * data, size_t len);
+
+/**
+ * Format and write to stdout (fd = 1) or stderr (fd = 2) through the buffered writers
+ */
+void _yrt_out_printf (int fd, const char * format, ...);
+
+/**
+ * Flush the buffered writer of stdout (fd = 1) or stderr (fd = 2)
+ */
+void _yrt_out_flush (int fd);
+
 /**
  * Print a utf8 char code in stdout
  */
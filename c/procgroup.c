@@ -0,0 +1,89 @@
+#ifdef __linux__
+
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include "yarray.h"
+
+/**
+ * Create an epoll set, used to wait for the events of many file descriptors with a single thread
+ * @returns: the file descriptor of the set, -1 on failure (the reason is left in errno)
+ */
+int _yrt_epoll_create (void) {
+    return epoll_create1 (EPOLL_CLOEXEC);
+}
+
+/**
+ * Register a file descriptor in an epoll set, to be notified when it is readable or closed
+ * @params:
+ *    - tag: the value returned by _yrt_epoll_wait when fd has an event
+ * @returns: 0 on success, -1 on failure (the reason is left in errno)
+ */
+int _yrt_epoll_add (int epfd, int fd, uint64_t tag) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = tag;
+    return epoll_ctl (epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**
+ * Remove a file descriptor from an epoll set
+ * @info: closing a file descriptor removes it from the sets automatically
+ */
+int _yrt_epoll_del (int epfd, int fd) {
+    struct epoll_event ev; // ignored, but must not be null before linux 2.6.9
+    return epoll_ctl (epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+/**
+ * Wait for events in an epoll set
+ * @params:
+ *    - tags: filled with the tags of the file descriptors that have an event, its size is the maximal number of events returned
+ *    - timeout: the maximal waiting time in milliseconds, -1 to wait indefinitely
+ * @returns: the number of events (0 on timeout, or if the waiting was interrupted by a signal), -1 on failure
+ */
+int _yrt_epoll_wait (int epfd, _yrt_array_ tags, int timeout) {
+    struct epoll_event events [64];
+    int max = tags.len < 64 ? (int) tags.len : 64;
+    int n = epoll_wait (epfd, events, max, timeout);
+    if (n == -1) return errno == EINTR ? 0 : -1;
+
+    uint64_t * res = (uint64_t*) tags.data;
+    for (int i = 0 ; i < n ; i++) res [i] = events [i].data.u64;
+    return n;
+}
+
+/**
+ * Get a file descriptor referring to a process, it becomes readable when the process exits
+ * @returns: the file descriptor, -1 on failure (ENOSYS before linux 5.3)
+ */
+int _yrt_pidfd_open (int pid) {
+#ifdef SYS_pidfd_open
+    return (int) syscall (SYS_pidfd_open, pid, 0);
+#else
+    (void) pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * Reap a child process if it has exited, without waiting
+ * @params:
+ *    - status: set to the exit status (as returned by waitpid) when the process has exited
+ * @returns: 1 if the process has exited, 0 if it is still running, -1 on failure (e.g. the process was already reaped)
+ */
+int _yrt_pid_try_wait (int pid, int * status) {
+    int r;
+    do {
+	r = waitpid (pid, status, WNOHANG);
+    } while (r == -1 && errno == EINTR);
+
+    if (r == -1) return -1;
+    return r == pid ? 1 : 0;
+}
+
+#endif
@@ -16,6 +16,34 @@ void** __YRT_ELF_LOADER__ = 0;
 void** __YRT_REFLECT_SYMBOL_TABLE__ = 0;
 void** __YRT_INV_REFLECT_SYMBOL_TABLE__ = 0;
 
+/**
+ * The symbol tables and the elf loader are created lazily, and read without lock
+ * They are published with a release store and read with an acquire load, so a thread that sees a table also sees the map behind it.
+ */
+void** _yrt_reflect_symbol_table () {
+    return __atomic_load_n (&__YRT_REFLECT_SYMBOL_TABLE__, __ATOMIC_ACQUIRE);
+}
+
+void** _yrt_reflect_inv_symbol_table () {
+    return __atomic_load_n (&__YRT_INV_REFLECT_SYMBOL_TABLE__, __ATOMIC_ACQUIRE);
+}
+
+void** _yrt_reflect_elf_loader () {
+    return __atomic_load_n (&__YRT_ELF_LOADER__, __ATOMIC_ACQUIRE);
+}
+
+void _yrt_reflect_publish_elf_loader (void** loader) {
+    __atomic_store_n (&__YRT_ELF_LOADER__, loader, __ATOMIC_RELEASE);
+}
+
+/**
+ * Publish the symbol tables, the table by address first, so it is visible to every thread that sees the table by name
+ */
+void _yrt_reflect_publish_symbol_tables (void** table, void** invTable) {
+    __atomic_store_n (&__YRT_INV_REFLECT_SYMBOL_TABLE__, invTable, __ATOMIC_RELEASE);
+    __atomic_store_n (&__YRT_REFLECT_SYMBOL_TABLE__, table, __ATOMIC_RELEASE);
+}
+
 
 static struct ReflectSymbolTable __yrt_reflectSymbolTable__ =
 { .numberOfEntries = 0,
@@ -0,0 +1,120 @@
+#ifdef __linux__
+
+#define _GNU_SOURCE // posix_spawn_file_actions_addchdir_np
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include "yarray.h"
+
+extern char ** environ;
+
+#if defined (__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#  define _YRT_SPAWN_CHDIR
+#endif
+
+/**
+ * Create the null terminated argument vector of a command, allocated with malloc
+ * The strings are not allocated by the GC, so the vector can be used without interaction with the collector.
+ */
+static char ** _yrt_spawn_argv (const char * cmd, _yrt_array_ args) {
+    const _yrt_c8_array_ * a = (const _yrt_c8_array_*) args.data;
+    uint64_t total = strlen (cmd) + 1;
+    for (uint64_t i = 0 ; i < args.len ; i++) total += a [i].len + 1;
+
+    char ** argv = (char**) malloc (sizeof (char*) * (args.len + 2) + total);
+    if (argv == NULL) return NULL;
+
+    char * str = (char*) (argv + args.len + 2);
+    argv [0] = str;
+    strcpy (str, cmd);
+    str += strlen (cmd) + 1;
+
+    for (uint64_t i = 0 ; i < args.len ; i++) {
+	argv [i + 1] = str;
+	memcpy (str, a [i].data, a [i].len);
+	str [a [i].len] = '\0';
+	str += a [i].len + 1;
+    }
+
+    argv [args.len + 1] = NULL;
+    return argv;
+}
+
+/**
+ * Spawn a process without duplicating the address space of the current one (fork)
+ * posix_spawn uses a vfork-like clone, so the cost does not depend on the size of the heap, and the collector does not need to be stopped.
+ * @params:
+ *    - cmd: the command to run (searched in the PATH if it does not contain a '/')
+ *    - args: the arguments of the command (without the command itself)
+ *    - cwd: the working directory of the process
+ *    - in, out, err: the file descriptors used as stdin, stdout and stderr by the process, -1 to inherit the ones of the current process
+ *    - closeFds: the file descriptors that must not be inherited by the process (the other ends of the pipes), they should already be close-on-exec (pipe2), this is only a safety net
+ *    - pid: set to the pid of the process
+ * @returns: 0 on success, the error code otherwise (e.g. ENOENT if the command does not exist)
+ */
+int _yrt_spawn_process (const char * cmd, _yrt_array_ args, const char * cwd, int in, int out, int err, _yrt_array_ closeFds, int * pid) {
+    const int * toClose = (const int*) closeFds.data;
+    for (uint64_t i = 0 ; i < closeFds.len ; i++) {
+	if (toClose [i] > 2) fcntl (toClose [i], F_SETFD, FD_CLOEXEC);
+    }
+
+    char ** argv = _yrt_spawn_argv (cmd, args);
+    if (argv == NULL) return ENOMEM;
+
+    int r;
+#ifdef _YRT_SPAWN_CHDIR
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init (&actions);
+    if (cwd != NULL && strcmp (cwd, ".") != 0) posix_spawn_file_actions_addchdir_np (&actions, cwd);
+    if (in != -1) posix_spawn_file_actions_adddup2 (&actions, in, STDIN_FILENO);
+    if (out != -1) posix_spawn_file_actions_adddup2 (&actions, out, STDOUT_FILENO);
+    if (err != -1) posix_spawn_file_actions_adddup2 (&actions, err, STDERR_FILENO);
+
+    pid_t p = 0;
+    r = posix_spawnp (&p, cmd, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy (&actions);
+#else
+    // No chdir file action, the child of vfork shares the memory of the parent until exec, so it only calls async signal safe functions
+    int status [2];
+    if (pipe2 (status, O_CLOEXEC) != 0) {
+	free (argv);
+	return errno;
+    }
+
+    pid_t p = vfork ();
+    if (p == 0) {
+	if ((cwd != NULL && chdir (cwd) != 0) ||
+	    (in != -1 && dup2 (in, STDIN_FILENO) == -1) ||
+	    (out != -1 && dup2 (out, STDOUT_FILENO) == -1) ||
+	    (err != -1 && dup2 (err, STDERR_FILENO) == -1)) {
+	    int e = errno;
+	    ssize_t w = write (status [1], &e, sizeof (int));
+	    (void) w;
+	    _exit (127);
+	}
+
+	execvp (cmd, argv);
+	int e = errno;
+	ssize_t w = write (status [1], &e, sizeof (int));
+	(void) w;
+	_exit (127);
+    }
+
+    close (status [1]);
+    r = 0;
+    if (p == -1) r = errno;
+    else if (read (status [0], &r, sizeof (int)) != sizeof (int)) r = 0; // closed by exec
+    close (status [0]);
+#endif
+
+    free (argv);
+    *pid = (int) p;
+    return r;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <string.h>
+#include "yarray.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#define _YRT_SYNTAX_X86
+#endif
+
+/**
+ * A byte set used by the tokenizer is a table of 288 bytes :
+ *    - [0 .. 256]: the membership of each byte (0 if not in the set)
+ *    - [256 .. 272]: the classification of the low nibble of the bytes
+ *    - [272 .. 288]: the classification of the high nibble of the bytes
+ * A byte b is in the set iif (lo [b & 0xf] & hi [b >> 4]) != 0, which can be tested on 16 bytes at once with two shuffles.
+ */
+#define _YRT_SET_LO 256
+#define _YRT_SET_HI 272
+
+/**
+ * Compute the nibble classification of a byte set from its membership table
+ * Each distinct high nibble of the set gets one bit, so the classification is exact only if there are at most 8 of them
+ * @params:
+ *    - set: the byte set (288 bytes), whose membership table is filled
+ * @returns: 1 if the classification is exact and can be used to scan, 0 otherwise
+ */
+uint8_t _yrt_syntax_build_byte_set (_yrt_array_ set) {
+    uint8_t * s = (uint8_t*) set.data;
+    memset (s + _YRT_SET_LO, 0, 32);
+
+    uint8_t nb = 0;
+    for (int h = 0 ; h < 16 ; h++) {
+	uint8_t used = 0;
+	for (int l = 0 ; l < 16 ; l++) {
+	    if (s [(h << 4) | l] != 0) { used = 1; break; }
+	}
+
+	if (!used) continue;
+	if (nb == 8) return 0;
+
+	uint8_t bit = (uint8_t) (1 << nb);
+	nb += 1;
+	s [_YRT_SET_HI + h] = bit;
+	for (int l = 0 ; l < 16 ; l++) {
+	    if (s [(h << 4) | l] != 0) s [_YRT_SET_LO + l] |= bit;
+	}
+    }
+
+    return 1;
+}
+
+static uint64_t _yrt_syntax_scan_scalar (const uint8_t * str, uint64_t from, uint64_t len, const uint8_t * s, uint8_t member) {
+    for (uint64_t i = from ; i < len ; i++) {
+	if ((s [str [i]] != 0) == member) return i;
+    }
+    return len;
+}
+
+#ifdef _YRT_SYNTAX_X86
+__attribute__ ((target ("ssse3")))
+static uint64_t _yrt_syntax_scan_ssse3 (const uint8_t * str, uint64_t len, const uint8_t * s, uint8_t member) {
+    const __m128i lo = _mm_loadu_si128 ((const __m128i*) (s + _YRT_SET_LO));
+    const __m128i hi = _mm_loadu_si128 ((const __m128i*) (s + _YRT_SET_HI));
+    const __m128i mask = _mm_set1_epi8 (0x0f);
+    const __m128i zero = _mm_setzero_si128 ();
+
+    uint64_t i = 0;
+    for (; i + 16 <= len ; i += 16) {
+	__m128i v = _mm_loadu_si128 ((const __m128i*) (str + i));
+	__m128i l = _mm_shuffle_epi8 (lo, _mm_and_si128 (v, mask));
+	__m128i h = _mm_shuffle_epi8 (hi, _mm_and_si128 (_mm_srli_epi16 (v, 4), mask));
+	// bit set in out iif the byte is not in the set
+	uint32_t out = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (l, h), zero));
+	if (member) out = ~out & 0xffff;
+	if (out != 0) return i + (uint64_t) __builtin_ctz (out);
+    }
+
+    return _yrt_syntax_scan_scalar (str, i, len, s, member);
+}
+#endif
+
+/**
+ * Find the first byte of str that is (or is not) in a byte set
+ * @params:
+ *    - str: the string to scan
+ *    - set: the byte set (288 bytes)
+ *    - exact: the value returned by _yrt_syntax_build_byte_set for that set
+ *    - member: 1 to find the first byte in the set, 0 to find the first byte not in the set
+ * @returns: the index of the byte, str.len if there is none
+ */
+uint64_t _yrt_syntax_scan_bytes (_yrt_array_ str, _yrt_array_ set, uint8_t exact, uint8_t member) {
+    const uint8_t * p = (const uint8_t*) str.data;
+    const uint8_t * s = (const uint8_t*) set.data;
+#ifdef _YRT_SYNTAX_X86
+    if (exact && str.len >= 16 && __builtin_cpu_supports ("ssse3")) {
+	return _yrt_syntax_scan_ssse3 (p, str.len, s, member);
+    }
+#endif
+
+    return _yrt_syntax_scan_scalar (p, 0, str.len, s, member);
+}
@@ -0,0 +1,414 @@
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // accept4
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "yarray.h"
+#include "gc.h"
+
+#if defined (__has_include)
+#  if __has_include (<linux/io_uring.h>) && defined (__NR_io_uring_setup)
+#    include <linux/io_uring.h>
+#    define _YRT_HAS_URING
+#  endif
+#endif
+
+/**
+ * Operations of the io engine (std::io::uring), the same codes are used by the ring and by the emulation
+ */
+enum {
+    _YRT_IO_READ = 0,
+    _YRT_IO_WRITE = 1,
+    _YRT_IO_READV = 2,
+    _YRT_IO_WRITEV = 3,
+    _YRT_IO_ACCEPT = 4,
+    _YRT_IO_CONNECT = 5,
+    _YRT_IO_FSYNC = 6,
+    _YRT_IO_READ_FIXED = 7,
+    _YRT_IO_WRITE_FIXED = 8,
+    _YRT_IO_NOP = 9
+};
+
+#define _YRT_IO_FIXED_FILE 1 // the fd is the index of a registered file
+#define _YRT_IO_DATASYNC 2 // fsync only flushes the data (fdatasync)
+
+#define _YRT_IO_CURRENT_POS ((uint64_t) -1) // read/write at the current position of the file
+
+/**
+ * Create an array of iovec from a list of slices
+ * @returns: the iovecs, allocated by the GC, so they live as long as the request using them
+ */
+struct iovec * _yrt_io_iovecs (_yrt_array_ slices) {
+    const _yrt_c8_array_ * s = (const _yrt_c8_array_*) slices.data;
+    struct iovec * res = (struct iovec*) GC_malloc (sizeof (struct iovec) * (slices.len + 1));
+    for (uint64_t i = 0 ; i < slices.len ; i++) {
+	res [i].iov_base = s [i].data;
+	res [i].iov_len = s [i].len;
+    }
+
+    return res;
+}
+
+/**
+ * Execute an io operation synchronously, used when io_uring is not available
+ * @returns: the result of the operation, or -errno on failure (the same convention as the completions of io_uring)
+ */
+int64_t _yrt_io_emulate (int op, int fd, void * addr, uint64_t len, uint64_t offset, int flags) {
+    int64_t r;
+    do {
+	switch (op) {
+	case _YRT_IO_READ:
+	case _YRT_IO_READ_FIXED:
+	    r = offset == _YRT_IO_CURRENT_POS ? read (fd, addr, len) : pread (fd, addr, len, (off_t) offset);
+	    break;
+	case _YRT_IO_WRITE:
+	case _YRT_IO_WRITE_FIXED:
+	    r = offset == _YRT_IO_CURRENT_POS ? write (fd, addr, len) : pwrite (fd, addr, len, (off_t) offset);
+	    break;
+	case _YRT_IO_READV:
+	    r = offset == _YRT_IO_CURRENT_POS ? readv (fd, addr, (int) len) : preadv (fd, addr, (int) len, (off_t) offset);
+	    break;
+	case _YRT_IO_WRITEV:
+	    r = offset == _YRT_IO_CURRENT_POS ? writev (fd, addr, (int) len) : pwritev (fd, addr, (int) len, (off_t) offset);
+	    break;
+	case _YRT_IO_ACCEPT:
+	    r = accept4 (fd, NULL, NULL, SOCK_CLOEXEC);
+	    break;
+	case _YRT_IO_CONNECT:
+	    r = connect (fd, (const struct sockaddr*) addr, (socklen_t) offset);
+	    break;
+	case _YRT_IO_FSYNC:
+	    r = (flags & _YRT_IO_DATASYNC) ? fdatasync (fd) : fsync (fd);
+	    break;
+	case _YRT_IO_NOP:
+	    r = 0;
+	    break;
+	default:
+	    errno = EINVAL;
+	    r = -1;
+	}
+    } while (r == -1 && errno == EINTR && op != _YRT_IO_CONNECT); // an interrupted connect continues asynchronously
+
+    return r == -1 ? -(int64_t) errno : r;
+}
+
+#ifdef _YRT_HAS_URING
+
+/**
+ * A ring shared with the kernel
+ * The submission queue is protected by a mutex, as many threads can submit operations, the completion queue is read by only one thread
+ */
+typedef struct _yrt_uring_ {
+    int fd;
+    unsigned entries;
+
+    unsigned * sq_head;
+    unsigned * sq_tail;
+    unsigned * sq_mask;
+    unsigned * sq_array;
+    struct io_uring_sqe * sqes;
+
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    unsigned * cq_mask;
+    struct io_uring_cqe * cqes;
+
+    void * sq_ptr;
+    size_t sq_size;
+    void * cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+    unsigned to_submit; // the number of entries in the submission queue not yet given to the kernel
+    pthread_mutex_t lock;
+} _yrt_uring_;
+
+static int _yrt_uring_enter (int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall (__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/**
+ * Give the prepared entries to the kernel (the lock must be held)
+ */
+static int _yrt_uring_flush (_yrt_uring_ * ring) {
+    while (ring-> to_submit != 0) {
+	int r = _yrt_uring_enter (ring-> fd, ring-> to_submit, 0, 0);
+	if (r < 0) {
+	    if (errno == EINTR) continue;
+	    return -errno;
+	}
+
+	ring-> to_submit -= (unsigned) r;
+    }
+
+    return 0;
+}
+
+void _yrt_uring_destroy (_yrt_uring_ * ring);
+
+/**
+ * Create a ring
+ * @params:
+ *    - entries: the size of the submission queue (rounded to a power of 2 by the kernel)
+ * @returns: the ring, NULL if io_uring is not available (the reason is left in errno)
+ */
+_yrt_uring_ * _yrt_uring_create (uint32_t entries) {
+    struct io_uring_params p;
+    memset (&p, 0, sizeof (p));
+
+    int fd = (int) syscall (__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return NULL;
+
+    _yrt_uring_ * ring = (_yrt_uring_*) calloc (1, sizeof (_yrt_uring_));
+    ring-> fd = fd;
+    ring-> entries = p.sq_entries;
+    ring-> sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    ring-> cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+    ring-> sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    pthread_mutex_init (&ring-> lock, NULL);
+
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+	if (ring-> cq_size > ring-> sq_size) ring-> sq_size = ring-> cq_size;
+	ring-> cq_size = ring-> sq_size;
+    }
+
+    ring-> sq_ptr = mmap (NULL, ring-> sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring-> sq_ptr == MAP_FAILED) {
+	ring-> sq_ptr = NULL;
+	goto fail;
+    }
+
+    if (single) ring-> cq_ptr = ring-> sq_ptr;
+    else {
+	ring-> cq_ptr = mmap (NULL, ring-> cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	if (ring-> cq_ptr == MAP_FAILED) {
+	    ring-> cq_ptr = NULL;
+	    goto fail;
+	}
+    }
+
+    ring-> sqes = (struct io_uring_sqe*) mmap (NULL, ring-> sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring-> sqes == MAP_FAILED) {
+	ring-> sqes = NULL;
+	goto fail;
+    }
+
+    char * sq = (char*) ring-> sq_ptr;
+    ring-> sq_head = (unsigned*) (sq + p.sq_off.head);
+    ring-> sq_tail = (unsigned*) (sq + p.sq_off.tail);
+    ring-> sq_mask = (unsigned*) (sq + p.sq_off.ring_mask);
+    ring-> sq_array = (unsigned*) (sq + p.sq_off.array);
+
+    char * cq = (char*) ring-> cq_ptr;
+    ring-> cq_head = (unsigned*) (cq + p.cq_off.head);
+    ring-> cq_tail = (unsigned*) (cq + p.cq_off.tail);
+    ring-> cq_mask = (unsigned*) (cq + p.cq_off.ring_mask);
+    ring-> cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+
+    return ring;
+
+ fail: {
+	int err = errno;
+	_yrt_uring_destroy (ring);
+	errno = err;
+	return NULL;
+    }
+}
+
+/**
+ * Close a ring, the operations that were not completed are cancelled by the kernel
+ */
+void _yrt_uring_destroy (_yrt_uring_ * ring) {
+    if (ring == NULL) return;
+    if (ring-> sqes != NULL) munmap (ring-> sqes, ring-> sqes_size);
+    if (ring-> cq_ptr != NULL && ring-> cq_ptr != ring-> sq_ptr) munmap (ring-> cq_ptr, ring-> cq_size);
+    if (ring-> sq_ptr != NULL) munmap (ring-> sq_ptr, ring-> sq_size);
+
+    close (ring-> fd);
+    pthread_mutex_destroy (&ring-> lock);
+    free (ring);
+}
+
+/**
+ * Add an operation in the submission queue, the queue is given to the kernel if it is full
+ * @params:
+ *    - op: the operation (_YRT_IO_*)
+ *    - fd: the file descriptor (or the index of a registered file if flags contains _YRT_IO_FIXED_FILE)
+ *    - addr: the buffer, the iovecs or the socket address
+ *    - len: the size of the buffer, or the number of iovecs
+ *    - offset: the offset in the file, or the size of the socket address
+ *    - bufIndex: the index of the registered buffer for the fixed operations
+ *    - userData: the value identifying the operation in its completion
+ *    - submit: if true, the queue is given to the kernel immediately
+ *    - flushErr: set to -errno if the operation was queued but the queue could not be given to the kernel, 0 otherwise
+ * @returns: 0 if the operation was queued, -errno otherwise
+ * @info: once queued, an operation is executed by the kernel even if the immediate submission failed (it is retried at the next submission), so its completion must still be awaited
+ */
+int _yrt_uring_push (_yrt_uring_ * ring, int op, int fd, void * addr, uint64_t len, uint64_t offset, int flags, uint16_t bufIndex, uint64_t userData, char submit, int * flushErr) {
+    *flushErr = 0;
+    pthread_mutex_lock (&ring-> lock);
+
+    unsigned tail = *ring-> sq_tail;
+    if (tail - __atomic_load_n (ring-> sq_head, __ATOMIC_ACQUIRE) >= ring-> entries) {
+	int r = _yrt_uring_flush (ring);
+	if (r < 0 || tail - __atomic_load_n (ring-> sq_head, __ATOMIC_ACQUIRE) >= ring-> entries) {
+	    pthread_mutex_unlock (&ring-> lock);
+	    return r < 0 ? r : -EBUSY;
+	}
+    }
+
+    unsigned index = tail & *ring-> sq_mask;
+    struct io_uring_sqe * sqe = &ring-> sqes [index];
+    memset (sqe, 0, sizeof (struct io_uring_sqe));
+    sqe-> fd = fd;
+    sqe-> user_data = userData;
+    if (flags & _YRT_IO_FIXED_FILE) sqe-> flags |= IOSQE_FIXED_FILE;
+
+    switch (op) {
+    case _YRT_IO_READ: sqe-> opcode = IORING_OP_READ; break;
+    case _YRT_IO_WRITE: sqe-> opcode = IORING_OP_WRITE; break;
+    case _YRT_IO_READV: sqe-> opcode = IORING_OP_READV; break;
+    case _YRT_IO_WRITEV: sqe-> opcode = IORING_OP_WRITEV; break;
+    case _YRT_IO_READ_FIXED: sqe-> opcode = IORING_OP_READ_FIXED; sqe-> buf_index = bufIndex; break;
+    case _YRT_IO_WRITE_FIXED: sqe-> opcode = IORING_OP_WRITE_FIXED; sqe-> buf_index = bufIndex; break;
+    case _YRT_IO_ACCEPT: sqe-> opcode = IORING_OP_ACCEPT; sqe-> accept_flags = SOCK_CLOEXEC; break;
+    case _YRT_IO_CONNECT: sqe-> opcode = IORING_OP_CONNECT; break;
+    case _YRT_IO_FSYNC:
+	sqe-> opcode = IORING_OP_FSYNC;
+	if (flags & _YRT_IO_DATASYNC) sqe-> fsync_flags = IORING_FSYNC_DATASYNC;
+	break;
+    default: sqe-> opcode = IORING_OP_NOP; break;
+    }
+
+    switch (op) {
+    case _YRT_IO_READ: case _YRT_IO_WRITE: case _YRT_IO_READV: case _YRT_IO_WRITEV:
+    case _YRT_IO_READ_FIXED: case _YRT_IO_WRITE_FIXED:
+	sqe-> addr = (uint64_t) (uintptr_t) addr;
+	sqe-> len = (uint32_t) len;
+	sqe-> off = offset;
+	break;
+    case _YRT_IO_CONNECT:
+	sqe-> addr = (uint64_t) (uintptr_t) addr;
+	sqe-> off = offset; // the length of the address
+	break;
+    default: break;
+    }
+
+    ring-> sq_array [index] = index;
+    __atomic_store_n (ring-> sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring-> to_submit += 1;
+
+    if (submit) *flushErr = _yrt_uring_flush (ring);
+    pthread_mutex_unlock (&ring-> lock);
+    return 0;
+}
+
+/**
+ * Give the operations of the submission queue to the kernel
+ * @returns: 0 on success, -errno otherwise
+ */
+int _yrt_uring_submit (_yrt_uring_ * ring) {
+    pthread_mutex_lock (&ring-> lock);
+    int r = _yrt_uring_flush (ring);
+    pthread_mutex_unlock (&ring-> lock);
+    return r;
+}
+
+/**
+ * Wait for the completion of an operation
+ * @params:
+ *    - userData: set to the value identifying the completed operation
+ *    - res: set to the result of the operation (-errno on failure)
+ * @returns: 0 on success, -errno if the waiting failed
+ * @warning: only one thread can wait on a given ring
+ */
+int _yrt_uring_wait (_yrt_uring_ * ring, uint64_t * userData, int64_t * res) {
+    for (;;) {
+	unsigned head = *ring-> cq_head;
+	if (head != __atomic_load_n (ring-> cq_tail, __ATOMIC_ACQUIRE)) {
+	    struct io_uring_cqe * cqe = &ring-> cqes [head & *ring-> cq_mask];
+	    *userData = cqe-> user_data;
+	    *res = cqe-> res;
+	    __atomic_store_n (ring-> cq_head, head + 1, __ATOMIC_RELEASE);
+	    return 0;
+	}
+
+	if (_yrt_uring_enter (ring-> fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+	    return -errno;
+	}
+    }
+}
+
+/**
+ * Register buffers, that can then be used by the fixed operations without being mapped by the kernel at each operation
+ * @params:
+ *    - iovecs: the buffers (created by _yrt_io_iovecs)
+ *    - nb: the number of buffers
+ * @returns: 0 on success, -errno otherwise
+ */
+int _yrt_uring_register_buffers (_yrt_uring_ * ring, struct iovec * iovecs, uint32_t nb) {
+    syscall (__NR_io_uring_register, ring-> fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    if (nb == 0) return 0;
+    return syscall (__NR_io_uring_register, ring-> fd, IORING_REGISTER_BUFFERS, iovecs, nb) < 0 ? -errno : 0;
+}
+
+/**
+ * Register file descriptors, that can then be referenced by their index with the flag _YRT_IO_FIXED_FILE
+ * @returns: 0 on success, -errno otherwise
+ */
+int _yrt_uring_register_files (_yrt_uring_ * ring, const int * fds, uint32_t nb) {
+    syscall (__NR_io_uring_register, ring-> fd, IORING_UNREGISTER_FILES, NULL, 0);
+    if (nb == 0) return 0;
+    return syscall (__NR_io_uring_register, ring-> fd, IORING_REGISTER_FILES, fds, nb) < 0 ? -errno : 0;
+}
+
+#else
+
+typedef struct _yrt_uring_ _yrt_uring_;
+
+_yrt_uring_ * _yrt_uring_create (uint32_t entries) {
+    (void) entries;
+    errno = ENOSYS;
+    return NULL;
+}
+
+void _yrt_uring_destroy (_yrt_uring_ * ring) { (void) ring; }
+
+int _yrt_uring_push (_yrt_uring_ * ring, int op, int fd, void * addr, uint64_t len, uint64_t offset, int flags, uint16_t bufIndex, uint64_t userData, char submit, int * flushErr) {
+    (void) ring; (void) op; (void) fd; (void) addr; (void) len; (void) offset; (void) flags; (void) bufIndex; (void) userData; (void) submit;
+    *flushErr = 0;
+    return -ENOSYS;
+}
+
+int _yrt_uring_submit (_yrt_uring_ * ring) { (void) ring; return -ENOSYS; }
+
+int _yrt_uring_wait (_yrt_uring_ * ring, uint64_t * userData, int64_t * res) {
+    (void) ring; (void) userData; (void) res;
+    return -ENOSYS;
+}
+
+int _yrt_uring_register_buffers (_yrt_uring_ * ring, struct iovec * iovecs, uint32_t nb) {
+    (void) ring; (void) iovecs; (void) nb;
+    return -ENOSYS;
+}
+
+int _yrt_uring_register_files (_yrt_uring_ * ring, const int * fds, uint32_t nb) {
+    (void) ring; (void) fds; (void) nb;
+    return -ENOSYS;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <string.h>
+#include "utf8.h"
+#include "yarray.h"
+#include "print.h"
+#include "gc.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <emmintrin.h>
+#define _YRT_UTF8_SSE2
+#endif
+
+/**
+ * Decode the utf8 sequence at the beginning of p (that contains len > 0 bytes)
+ * @returns: the number of bytes of the sequence, 0 if it is not valid
+ */
+static size_t _yrt_utf8_decode_one (const uint8_t * p, size_t len, uint32_t * code) {
+    uint8_t c = p [0];
+    if (c < 0x80) {
+	*code = c;
+	return 1;
+    }
+
+    size_t n;
+    uint8_t lo = 0x80, hi = 0xbf;
+    uint32_t res;
+    if (c >= 0xc2 && c <= 0xdf) { n = 1; res = c & 0x1f; }
+    else if (c >= 0xe0 && c <= 0xef) {
+	n = 2; res = c & 0x0f;
+	if (c == 0xe0) lo = 0xa0; // overlong
+	else if (c == 0xed) hi = 0x9f; // surrogates
+    } else if (c >= 0xf0 && c <= 0xf4) {
+	n = 3; res = c & 0x07;
+	if (c == 0xf0) lo = 0x90; // overlong
+	else if (c == 0xf4) hi = 0x8f; // above 0x10FFFF
+    } else return 0;
+
+    if (n >= len) return 0; // truncated sequence
+    if (p [1] < lo || p [1] > hi) return 0;
+    res = (res << 6) | (p [1] & 0x3f);
+    for (size_t j = 2 ; j <= n ; j++) {
+	if ((p [j] & 0xc0) != 0x80) return 0;
+	res = (res << 6) | (p [j] & 0x3f);
+    }
+
+    *code = res;
+    return n + 1;
+}
+
+/**
+ * @returns: the number of leading ascii bytes of p
+ */
+static size_t _yrt_utf8_ascii_prefix (const uint8_t * p, size_t len) {
+    size_t i = 0;
+#ifdef _YRT_UTF8_SSE2
+    while (i + 16 <= len) {
+	int mask = _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i*) (p + i)));
+	if (mask != 0) return i + __builtin_ctz (mask);
+	i += 16;
+    }
+#endif
+    while (i + 8 <= len) {
+	uint64_t w;
+	memcpy (&w, p + i, 8);
+	if ((w & 0x8080808080808080ULL) != 0) break;
+	i += 8;
+    }
+
+    while (i < len && p [i] < 0x80) i++;
+    return i;
+}
+
+size_t _yrt_utf8_valid_prefix (const char * src, size_t len) {
+    const uint8_t * p = (const uint8_t*) src;
+    size_t i = 0;
+    while (i < len) {
+	i += _yrt_utf8_ascii_prefix (p + i, len - i);
+	if (i == len) break;
+
+	uint32_t code;
+	size_t n = _yrt_utf8_decode_one (p + i, len - i, &code);
+	if (n == 0) return i;
+	i += n;
+    }
+
+    return len;
+}
+
+size_t _yrt_utf8_count (const char * src, size_t len) {
+    const uint8_t * p = (const uint8_t*) src;
+    if (_yrt_utf8_valid_prefix (src, len) == len) {
+	// valid string, each code point has exactly one byte that is not a continuation byte (10xxxxxx)
+	size_t count = 0, i = 0;
+#ifdef _YRT_UTF8_SSE2
+	const __m128i limit = _mm_set1_epi8 ((char) 0xbf);
+	while (i + 16 <= len) {
+	    __m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+	    // continuation bytes are -128 .. -65 as signed bytes
+	    int mask = _mm_movemask_epi8 (_mm_cmpgt_epi8 (v, limit));
+	    count += __builtin_popcount (mask);
+	    i += 16;
+	}
+#endif
+	for (; i < len ; i++) {
+	    if ((p [i] & 0xc0) != 0x80) count += 1;
+	}
+
+	return count;
+    }
+
+    size_t count = 0, i = 0;
+    while (i < len) {
+	uint32_t code;
+	size_t n = _yrt_utf8_decode_one (p + i, len - i, &code);
+	i += (n == 0) ? 1 : n;
+	count += 1;
+    }
+
+    return count;
+}
+
+size_t _yrt_utf8_to_utf32 (const char * src, size_t len, uint32_t * dst) {
+    const uint8_t * p = (const uint8_t*) src;
+    size_t i = 0, j = 0;
+    while (i < len) {
+#ifdef _YRT_UTF8_SSE2
+	// ascii fast path, 16 bytes are widened to 16 code points at a time
+	const __m128i zero = _mm_setzero_si128 ();
+	while (i + 16 <= len) {
+	    __m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+	    if (_mm_movemask_epi8 (v) != 0) break;
+
+	    __m128i lo = _mm_unpacklo_epi8 (v, zero), hi = _mm_unpackhi_epi8 (v, zero);
+	    _mm_storeu_si128 ((__m128i*) (dst + j), _mm_unpacklo_epi16 (lo, zero));
+	    _mm_storeu_si128 ((__m128i*) (dst + j + 4), _mm_unpackhi_epi16 (lo, zero));
+	    _mm_storeu_si128 ((__m128i*) (dst + j + 8), _mm_unpacklo_epi16 (hi, zero));
+	    _mm_storeu_si128 ((__m128i*) (dst + j + 12), _mm_unpackhi_epi16 (hi, zero));
+	    i += 16;
+	    j += 16;
+	}
+#endif
+	while (i < len && p [i] < 0x80) {
+	    dst [j++] = p [i++];
+	}
+
+	if (i == len) break;
+
+	uint32_t code;
+	size_t n = _yrt_utf8_decode_one (p + i, len - i, &code);
+	if (n == 0) {
+	    dst [j++] = 0xFFFD;
+	    i += 1;
+	} else {
+	    dst [j++] = code;
+	    i += n;
+	}
+    }
+
+    return j;
+}
+
+size_t _yrt_utf32_utf8_len (const uint32_t * src, size_t len) {
+    size_t total = 0, i = 0;
+#ifdef _YRT_UTF8_SSE2
+    const __m128i l1 = _mm_set1_epi32 (0x7f), l2 = _mm_set1_epi32 (0x7ff), l3 = _mm_set1_epi32 (0xffff);
+    const __m128i lmax = _mm_set1_epi32 (0x10ffff), zero = _mm_setzero_si128 ();
+    __m128i acc = _mm_setzero_si128 ();
+    for (; i + 4 <= len ; i += 4) {
+	__m128i c = _mm_loadu_si128 ((const __m128i*) (src + i));
+	__m128i invalid = _mm_or_si128 (_mm_cmpgt_epi32 (c, lmax), _mm_cmplt_epi32 (c, zero));
+	if (_mm_movemask_epi8 (invalid) != 0) break; // encoded as U+FFFD, counted by the scalar loop
+
+	// 1 byte, plus one for each limit that is exceeded (the comparisons give -1)
+	acc = _mm_sub_epi32 (acc, _mm_cmpgt_epi32 (c, l1));
+	acc = _mm_sub_epi32 (acc, _mm_cmpgt_epi32 (c, l2));
+	acc = _mm_sub_epi32 (acc, _mm_cmpgt_epi32 (c, l3));
+	total += 4;
+	if ((i & 0x3ffff) == 0x3fffc) { // avoid overflowing the 32 bits counters
+	    uint32_t lanes [4];
+	    _mm_storeu_si128 ((__m128i*) lanes, acc);
+	    total += (size_t) lanes [0] + lanes [1] + lanes [2] + lanes [3];
+	    acc = _mm_setzero_si128 ();
+	}
+    }
+
+    uint32_t lanes [4];
+    _mm_storeu_si128 ((__m128i*) lanes, acc);
+    total += (size_t) lanes [0] + lanes [1] + lanes [2] + lanes [3];
+#endif
+    for (; i < len ; i++) {
+	uint32_t code = src [i];
+	total += (code <= 0x7F) ? 1 : (code <= 0x7FF) ? 2 : (code <= 0xFFFF || code > 0x10FFFF) ? 3 : 4;
+    }
+
+    return total;
+}
+
+size_t _yrt_utf32_to_utf8 (const uint32_t * src, size_t len, char * dst) {
+    size_t j = 0, i = 0;
+    while (i < len) {
+#ifdef _YRT_UTF8_SSE2
+	// ascii fast path, 16 code points are narrowed to 16 bytes at a time
+	const __m128i high = _mm_set1_epi32 ((int) 0xffffff80);
+	while (i + 16 <= len) {
+	    __m128i a = _mm_loadu_si128 ((const __m128i*) (src + i));
+	    __m128i b = _mm_loadu_si128 ((const __m128i*) (src + i + 4));
+	    __m128i c = _mm_loadu_si128 ((const __m128i*) (src + i + 8));
+	    __m128i d = _mm_loadu_si128 ((const __m128i*) (src + i + 12));
+	    __m128i any = _mm_or_si128 (_mm_or_si128 (a, b), _mm_or_si128 (c, d));
+	    if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (any, high), _mm_setzero_si128 ())) != 0xffff) break;
+
+	    __m128i ab = _mm_packs_epi32 (a, b), cd = _mm_packs_epi32 (c, d);
+	    _mm_storeu_si128 ((__m128i*) (dst + j), _mm_packus_epi16 (ab, cd));
+	    i += 16;
+	    j += 16;
+	}
+#endif
+	while (i < len && src [i] < 0x80) {
+	    dst [j++] = (char) src [i++];
+	}
+
+	if (i == len) break;
+
+	int nb = 0;
+	_yrt_to_utf8 (src [i], dst + j, &nb);
+	j += nb;
+	i += 1;
+    }
+
+    return j;
+}
+
+_yrt_c8_array_ _yrt_to_utf8_array (_yrt_c32_array_ array) {
+    const uint32_t * src = (const uint32_t*) array.data;
+    size_t len = _yrt_utf32_utf8_len (src, array.len);
+    char * result = GC_malloc (len + 1);
+    _yrt_utf32_to_utf8 (src, array.len, result);
+
+    _yrt_c8_array_ arr;
+    arr.data = result;
+    arr.len = len;
+    return arr;
+}
+
+_yrt_c32_array_ _yrt_to_utf32_array (_yrt_c8_array_ array) {
+    size_t len = _yrt_utf8_count (array.data, array.len);
+    uint32_t * result = GC_malloc ((len + 1) * sizeof (uint32_t));
+    _yrt_utf8_to_utf32 (array.data, array.len, result);
+
+    _yrt_c32_array_ arr;
+    arr.data = (unsigned int*) result;
+    arr.len = len;
+    return arr;
+}
+
+uint64_t _yrt_utf8_valid_len (_yrt_c8_array_ str) {
+    return _yrt_utf8_valid_prefix (str.data, str.len);
+}
@@ -0,0 +1,36 @@
+#ifndef _UTF8_H_
+#define _UTF8_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @returns: the length of the longest valid utf8 prefix of the len bytes of src
+ */
+size_t _yrt_utf8_valid_prefix (const char * src, size_t len);
+
+/**
+ * @returns: the number of code points of the len bytes of src, each invalid byte counting as one code point
+ */
+size_t _yrt_utf8_count (const char * src, size_t len);
+
+/**
+ * Decode len utf8 bytes into dst, that must contain _yrt_utf8_count (src, len) code points
+ * Each byte that does not start a valid sequence is decoded as the replacement character U+FFFD
+ * @returns: the number of code points written
+ */
+size_t _yrt_utf8_to_utf32 (const char * src, size_t len, uint32_t * dst);
+
+/**
+ * @returns: the number of bytes of the utf8 encoding of the len code points of src
+ */
+size_t _yrt_utf32_utf8_len (const uint32_t * src, size_t len);
+
+/**
+ * Encode len utf32 code points into dst, that must contain at least _yrt_utf32_utf8_len (src, len) + 1 bytes
+ * The code points that are not valid (above 0x10FFFF) are encoded as the replacement character U+FFFD
+ * @returns: the number of bytes written
+ */
+size_t _yrt_utf32_to_utf8 (const uint32_t * src, size_t len, char * dst);
+
+#endif
@@ -50,6 +50,33 @@ _yrt_array_ _yrt_new_array (unsigned long size, unsigned long len) {
     return ret;
 }
 
+_yrt_array_ _yrt_grow_array (_yrt_array_ arr, unsigned long size, unsigned long len, unsigned long used) {
+    _yrt_array_ ret;
+    void * base = (arr.data != NULL) ? GC_base (arr.data) : NULL;
+    if (base != NULL && base == arr.data && GC_size (base) >= len * size) {
+	// The block allocated by the GC is already large enough (size classes are rounded up), the array can be extended in place
+	ret.len = GC_size (base) / size;
+	ret.data = arr.data;
+	return ret;
+    }
+
+    // Not using GC_realloc, as it frees the old block when moving it, and there can still be slices pointing to it
+    char * x = (char*) GC_malloc (len * size);
+    if (used > arr.len) used = arr.len;
+    if (used != 0) memcpy (x, arr.data, used * size);
+
+    ret.len = GC_size (x) / size;
+    ret.data = x;
+    return ret;
+}
+
+_yrt_array_ _yrt_slice_from_ptr (void * data, unsigned long len) {
+    _yrt_array_ ret;
+    ret.len = len;
+    ret.data = data;
+    return ret;
+}
+
 void* _yrt_dupl_any (void* data, unsigned long len) {
     char * x = GC_malloc (len);
     memcpy (x, data, len);
@@ -44,6 +44,26 @@ void* _yrt_new_block (unsigned long size, unsigned long len);
  */
 _yrt_array_ _yrt_new_array (unsigned long size, unsigned long len);
 
+/**
+ * Grow an array allocated with the GC, in place if the underlying block is large enough
+ * @params:
+ *    - arr: the array to grow
+ *    - size: the size of each element in the array
+ *    - len: the minimal number of elements of the grown array
+ *    - used: the number of elements of arr to keep when the array has to be moved
+ * @return: an array of at least len elements, whose len is the actual capacity of the block
+ */
+_yrt_array_ _yrt_grow_array (_yrt_array_ arr, unsigned long size, unsigned long len, unsigned long used);
+
+/**
+ * Create a slice from a raw pointer
+ * @params:
+ *    - data: the first element of the slice
+ *    - len: the number of elements
+ * @return: the slice (no allocation, no copy)
+ */
+_yrt_array_ _yrt_slice_from_ptr (void * data, unsigned long len);
+
 /**
  * Make a copy of a raw segment of data into another raw segment of data allocated with GC
  * @params: 